@@ -0,0 +1,140 @@
+/********************************************************************************
+ *                                                                              *
+ *          Porting the Essential Dynamics/Molecular Dynamics method            *
+ *             for large-scale nucleic acid simulations to ARCHER               *
+ *                                                                              *
+ *                               Zhuowei Si                                     *
+ *              EPCC supervisors: Elena Breitmoser, Iain Bethune                *
+ *     External supervisor: Charlie Laughton (The University of Nottingham)     *
+ *                                                                              *
+ *                  MSc in High Performance Computing, EPCC                     *
+ *                       The University of Edinburgh                            *
+ *                                                                              *
+ *******************************************************************************/
+
+/**
+ * File:  bench_pack.cpp
+ * Brief: The microbenchmark of the broadcast of the coordinates of tetrads (the
+ *        MPI_Datatype "MPI_Crds"), with the arrays of tetrads scattered on the heap
+ *        (allocate_Tetrad_Arrays) and packed into the contiguous buffers
+ *        (pack_Tetrad_Arrays)
+ *
+ * Usage: mpirun -n <ranks> bench/bench_pack [tetrads] [atoms] [repeats]
+ *        (default: 90 tetrads of 252 atoms, the 756 doubles of a tetrad of the
+ *        test system, 1000 broadcasts)
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include "mpi.h"
+
+#include "tetrad.hpp"
+#include "mpilib.hpp"
+
+using namespace std;
+
+#define BENCH_EVECS 20   // The number of eigenvectors of the tetrads of the benchmark
+#define BENCH_WARMUP 10  // The number of broadcasts before the timing
+
+/**
+ * Function:  Time the broadcasts of the coordinates of tetrads from rank 0, and
+ *            check the coordinates received
+ *
+ * Parameter: Tetrad* tetrad   -> The tetrads
+ *            int num_Tetrads  -> The number of tetrads
+ *            int repeats      -> The number of broadcasts
+ *            int rank         -> The rank of the process
+ *
+ * Return:    The time of a broadcast (in microseconds, the maximum of the ranks)
+ */
+double time_Broadcast(Tetrad* tetrad, int num_Tetrads, int repeats, int rank) {
+    
+    int i, j, errors = 0;
+    double start, time, max_Time;
+    MPI_Datatype MPI_Crds;
+    
+    MPI_Lib::create_MPI_Crds(&MPI_Crds, num_Tetrads, tetrad);
+    
+    for (i = 0; i < num_Tetrads; i++) {
+        for (j = 0; j < 3 * tetrad[i].num_Atoms; j++) {
+            tetrad[i].coordinates[j] = (rank == 0) ? i + 0.001 * j : 0.0;
+        }
+    }
+    
+    for (i = 0; i < BENCH_WARMUP; i++) { MPI_Bcast(tetrad, 1, MPI_Crds, 0, MPI_COMM_WORLD); }
+    
+    MPI_Barrier(MPI_COMM_WORLD);
+    start = MPI_Wtime();
+    for (i = 0; i < repeats; i++) { MPI_Bcast(tetrad, 1, MPI_Crds, 0, MPI_COMM_WORLD); }
+    time = (MPI_Wtime() - start) / repeats * 1.0e6;
+    
+    MPI_Reduce(&time, &max_Time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    
+    for (i = 0; i < num_Tetrads; i++) {
+        for (j = 0; j < 3 * tetrad[i].num_Atoms; j++) {
+            if (tetrad[i].coordinates[j] != i + 0.001 * j) errors++;
+        }
+    }
+    
+    if (errors > 0) {
+        cout << ">>> ERROR: Rank " << rank << " received " << errors << " wrong coordinates!" << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    
+    MPI_Lib::free_MPI_Crds(&MPI_Crds);
+    
+    return max_Time;
+    
+}
+
+
+
+int main(int argc, char *argv[]) {
+    
+    int i, rank, size;
+    int num_Tetrads = 90, num_Atoms = 252, repeats = 1000;
+    double scattered, packed;
+    
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    
+    if (argc > 1) num_Tetrads = atoi(argv[1]);
+    if (argc > 2) num_Atoms   = atoi(argv[2]);
+    if (argc > 3) repeats     = atoi(argv[3]);
+    
+    if (num_Tetrads < 1 || num_Atoms < 1 || repeats < 1) {
+        if (rank == 0) cout << ">>> ERROR: Usage: bench_pack [tetrads] [atoms] [repeats]" << endl;
+        MPI_Finalize();
+        return 1;
+    }
+    
+    // Every array of a tetrad is a separate allocation, as before the packing
+    Tetrad * tetrad = new Tetrad [num_Tetrads];
+    for (i = 0; i < num_Tetrads; i++) {
+        tetrad[i].num_Atoms = num_Atoms;
+        tetrad[i].num_Evecs = BENCH_EVECS;
+        tetrad[i].allocate_Tetrad_Arrays();
+    }
+    
+    scattered = time_Broadcast(tetrad, num_Tetrads, repeats, rank);
+    
+    Tetrad::pack_Tetrad_Arrays(tetrad, num_Tetrads);
+    
+    packed = time_Broadcast(tetrad, num_Tetrads, repeats, rank);
+    
+    if (rank == 0) {
+        cout << "Broadcast of the coordinates of " << num_Tetrads << " tetrads x "
+             << 3 * num_Atoms << " doubles, " << size << " ranks, " << repeats << " repeats" << endl;
+        cout << "Scattered arrays: " << scattered << " us per broadcast" << endl;
+        cout << "Packed buffers:   " << packed << " us per broadcast" << endl;
+    }
+    
+    Tetrad::deallocate_Packed_Arrays(tetrad, num_Tetrads);
+    delete [] tetrad;
+    
+    MPI_Finalize();
+    
+    return 0;
+    
+}
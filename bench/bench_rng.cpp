@@ -0,0 +1,118 @@
+/********************************************************************************
+ *                                                                              *
+ *          Porting the Essential Dynamics/Molecular Dynamics method            *
+ *             for large-scale nucleic acid simulations to ARCHER               *
+ *                                                                              *
+ *                               Zhuowei Si                                     *
+ *              EPCC supervisors: Elena Breitmoser, Iain Bethune                *
+ *     External supervisor: Charlie Laughton (The University of Nottingham)     *
+ *                                                                              *
+ *                  MSc in High Performance Computing, EPCC                     *
+ *                       The University of Edinburgh                            *
+ *                                                                              *
+ *******************************************************************************/
+
+/**
+ * File:  bench_rng.cpp
+ * Brief: The microbenchmark of the random terms: the normal numbers of a tetrad
+ *        at a step, for every tetrad & step in turn, with the RNG class
+ *        (RNG::generate_Normals) and the old generator (old_rng.hpp)
+ *
+ * Usage: bench/bench_rng [count] [tetrads] [steps]
+ *        (default: 756 numbers, the random terms of a tetrad of the test system,
+ *        90 tetrads & 1000 steps)
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <ctime>
+
+#include "rng.hpp"
+#include "old_rng.hpp"
+
+using namespace std;
+
+RNG rng; // The generator of the RNG class
+
+/**
+ * Function:  Generate the normal numbers of a tetrad with the RNG class
+ *
+ * Parameter: double* normals -> The normal numbers (output)
+ *            int count       -> The number of normal numbers
+ *            int stream      -> The stream (the tetrad)
+ *            int step        -> The step
+ *
+ * Return:    None
+ */
+void new_Normals(double* normals, int count, int stream, int step) {
+    
+    rng.generate_Normals(normals, count, stream, step);
+    
+}
+
+
+
+/**
+ * Function:  Time a generator for every tetrad & step in turn
+ *
+ * Parameter: void (*generate)(double*, int, int, int) -> The generator
+ *            double* normals                          -> The normal numbers of a tetrad
+ *            int count                                -> The number of normal numbers of a tetrad
+ *            int num_Tetrads                          -> The number of tetrads
+ *            int steps                                -> The number of steps
+ *            double* sum                              -> The checksum of the numbers (output)
+ *
+ * Return:    The time of a tetrad (in microseconds)
+ */
+double time_Normals(void (*generate)(double*, int, int, int), double* normals, int count,
+                    int num_Tetrads, int steps, double* sum) {
+    
+    int i, j;
+    clock_t start_Time = clock();
+    
+    for (i = 0; i < steps; i++) {
+        for (j = 0; j < num_Tetrads; j++) {
+            generate(normals, count, j, i);
+            *sum += normals[count - 1];
+        }
+    }
+    
+    return double (clock() - start_Time) / CLOCKS_PER_SEC / ((double) steps * num_Tetrads) * 1.0e6;
+    
+}
+
+
+
+int main(int argc, char *argv[]) {
+    
+    int count = 756, num_Tetrads = 90, steps = 1000;
+    double sum = 0.0, time_New, time_Old, * normals;
+    
+    if (argc > 1) count       = atoi(argv[1]);
+    if (argc > 2) num_Tetrads = atoi(argv[2]);
+    if (argc > 3) steps       = atoi(argv[3]);
+    
+    if (count < 1 || num_Tetrads < 1 || steps < 1) {
+        cout << ">>> ERROR: Usage: bench_rng [count] [tetrads] [steps]" << endl;
+        return 1;
+    }
+    
+    normals = new double [count];
+    
+    time_New = time_Normals(new_Normals, normals, count, num_Tetrads, steps, &sum);
+    time_Old = time_Normals(old_Normals, normals, count, num_Tetrads, steps, &sum);
+    
+    // The sum keeps the numbers from being optimised away
+    cout << "Normal numbers of " << num_Tetrads << " tetrads x " << count << " for "
+         << steps << " steps (checksum " << sum << ")" << endl;
+    cout << "Philox4x32-10 & Box-Muller, time of a tetrad: " << time_New << " us, of a number: "
+         << time_New / count * 1.0e3 << " ns" << endl;
+    cout << "Old rand & Kinderman-Monahan, time of a tetrad: " << time_Old << " us, of a number: "
+         << time_Old / count * 1.0e3 << " ns" << endl;
+    cout << "Speed-up: " << time_Old / time_New << endl;
+    
+    delete [] normals;
+    
+    return 0;
+    
+}
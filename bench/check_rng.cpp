@@ -0,0 +1,223 @@
+/********************************************************************************
+ *                                                                              *
+ *          Porting the Essential Dynamics/Molecular Dynamics method            *
+ *             for large-scale nucleic acid simulations to ARCHER               *
+ *                                                                              *
+ *                               Zhuowei Si                                     *
+ *              EPCC supervisors: Elena Breitmoser, Iain Bethune                *
+ *     External supervisor: Charlie Laughton (The University of Nottingham)     *
+ *                                                                              *
+ *                  MSc in High Performance Computing, EPCC                     *
+ *                       The University of Edinburgh                            *
+ *                                                                              *
+ *******************************************************************************/
+
+/**
+ * File:  check_rng.cpp
+ * Brief: The checks of the RNG class: the known-answer vectors of Philox4x32-10
+ *        (the kat_vectors of Random123), the reproducibility of the streams, and
+ *        the statistics of the normal numbers of Box-Muller (the moments, the
+ *        lag-1 correlation & the Kolmogorov-Smirnov test against the normal
+ *        distribution), side by side with the old generator (old_rng.hpp). The
+ *        bounds of the statistics are about 5 standard errors.
+ *
+ * Usage: bench/check_rng (make check), the exit code is 1 if a check fails
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <algorithm>
+
+#include "rng.hpp"
+#include "old_rng.hpp"
+
+using namespace std;
+
+#define CHECK_STREAMS 256  // The streams of the statistics (as tetrads)
+#define CHECK_STEPS   16   // The steps of every stream
+#define CHECK_COUNT   256  // The normal numbers of a stream at a step
+#define CHECK_KS      100000 // The normal numbers of the Kolmogorov-Smirnov test
+
+int failures = 0; // The number of the failed checks
+
+RNG rng;          // The generator of the RNG class
+
+/**
+ * Function:  Report a check
+ *
+ * Parameter: const char* name -> The name of the check
+ *            int passed       -> Whether the check passed
+ *            double value     -> The value of the check
+ *            double bound     -> The bound of the value
+ *
+ * Return:    None
+ */
+void report(const char* name, int passed, double value, double bound) {
+    
+    if (passed) {
+        cout << "Passed: " << name << " (" << value << ", bound " << bound << ")" << endl;
+    } else {
+        cout << ">>> ERROR: Failed: " << name << " (" << value << ", bound " << bound << ")" << endl;
+        failures++;
+    }
+    
+}
+
+
+
+/**
+ * Function:  Generate the normal numbers of a tetrad with the RNG class
+ *
+ * Parameter: double* normals -> The normal numbers (output)
+ *            int count       -> The number of normal numbers
+ *            int stream      -> The stream (the tetrad)
+ *            int step        -> The step
+ *
+ * Return:    None
+ */
+void new_Normals(double* normals, int count, int stream, int step) {
+    
+    rng.generate_Normals(normals, count, stream, step);
+    
+}
+
+
+
+/**
+ * Function:  Check Philox4x32-10 against the known-answer vectors of Random123
+ *
+ * Parameter: None
+ *
+ * Return:    None
+ */
+void check_Known_Answers(void) {
+    
+    unsigned int counter[3][4] = { { 0x00000000, 0x00000000, 0x00000000, 0x00000000 },
+                                   { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+                                   { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 } };
+    unsigned int key[3][2]     = { { 0x00000000, 0x00000000 },
+                                   { 0xffffffff, 0xffffffff },
+                                   { 0xa4093822, 0x299f31d0 } };
+    unsigned int answer[3][4]  = { { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 },
+                                   { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd },
+                                   { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } };
+    unsigned int random[4];
+    int i, wrong = 0;
+    
+    for (i = 0; i < 3; i++) {
+        RNG::philox_4x32(counter[i], key[i], random);
+        if (memcmp(random, answer[i], sizeof(random)) != 0) wrong++;
+    }
+    
+    report("Philox4x32-10 known-answer vectors (wrong)", wrong == 0, wrong, 0);
+    
+}
+
+
+
+/**
+ * Function:  Check that a stream at a step is reproducible, that the last partial
+ *            block is the prefix of the full one, and that the streams & the steps
+ *            differ
+ *
+ * Parameter: None
+ *
+ * Return:    None
+ */
+void check_Streams(void) {
+    
+    double a[8], b[8], c[8], d[8];
+    int same;
+    
+    rng.generate_Normals(a, 8, 7, 3);
+    rng.generate_Normals(b, 8, 7, 3);
+    report("Reproducible stream (same)", memcmp(a, b, sizeof(a)) == 0, 1, 1);
+    
+    rng.generate_Normals(b, 7, 7, 3);
+    report("Partial block as prefix (same)", memcmp(a, b, 7 * sizeof(double)) == 0, 1, 1);
+    
+    rng.generate_Normals(c, 8, 8, 3);
+    rng.generate_Normals(d, 8, 7, 4);
+    same = 0;
+    for (int i = 0; i < 8; i++) { same += (a[i] == c[i]) + (a[i] == d[i]); }
+    report("Distinct streams & steps (equal numbers)", same == 0, same, 0);
+    
+}
+
+
+
+/**
+ * Function:  Check the moments, the lag-1 correlation & the Kolmogorov-Smirnov
+ *            statistic of the normal numbers of many streams & steps
+ *
+ * Parameter: const char* name                         -> The name of the generator
+ *            void (*generate)(double*, int, int, int) -> The generator
+ *
+ * Return:    None
+ */
+void check_Normals(const char* name, void (*generate)(double*, int, int, int)) {
+    
+    long i, n = (long) CHECK_STREAMS * CHECK_STEPS * CHECK_COUNT;
+    double * x = new double [n];
+    double mean = 0.0, m2 = 0.0, m3 = 0.0, m4 = 0.0, lag = 0.0, d, ks = 0.0, se = 1.0 / sqrt(n);
+    string prefix = string(name) + ": ";
+    
+    for (int s = 0; s < CHECK_STREAMS; s++) {
+        for (int t = 0; t < CHECK_STEPS; t++) {
+            generate(x + ((long) s * CHECK_STEPS + t) * CHECK_COUNT, CHECK_COUNT, s, t);
+        }
+    }
+    
+    for (i = 0; i < n; i++) { mean += x[i]; }
+    mean /= n;
+    for (i = 0; i < n; i++) {
+        d = x[i] - mean;
+        m2 += d * d; m3 += d * d * d; m4 += d * d * d * d;
+        if (i > 0) lag += d * (x[i - 1] - mean);
+    }
+    m2 /= n; m3 /= n; m4 /= n;
+    m3  = m3 / pow(m2, 1.5);    // The skewness
+    m4  = m4 / (m2 * m2) - 3.0; // The excess kurtosis
+    lag = lag / (n * m2);       // The lag-1 correlation
+    
+    // The standard errors are 1, sqrt(2), sqrt(6), sqrt(24) & 1 over sqrt(n)
+    report((prefix + "Mean").c_str(),              fabs(mean)     < 5.0 * se,             mean,     5.0 * se);
+    report((prefix + "Variance - 1").c_str(),      fabs(m2 - 1.0) < 5.0 * sqrt(2.0) * se, m2 - 1.0, 5.0 * sqrt(2.0) * se);
+    report((prefix + "Skewness").c_str(),          fabs(m3)       < 5.0 * sqrt(6.0) * se, m3,       5.0 * sqrt(6.0) * se);
+    report((prefix + "Excess kurtosis").c_str(),   fabs(m4)       < 5.0 * sqrt(24.0) * se, m4,      5.0 * sqrt(24.0) * se);
+    report((prefix + "Lag-1 correlation").c_str(), fabs(lag)      < 5.0 * se,             lag,      5.0 * se);
+    
+    // The Kolmogorov-Smirnov statistic of the first numbers (1.95 / sqrt(n) is the
+    // critical value at the significance level 0.001)
+    sort(x, x + CHECK_KS);
+    for (i = 0; i < CHECK_KS; i++) {
+        d = 0.5 * erfc(-x[i] / sqrt(2.0));
+        ks = max(ks, max(fabs(d - (double) i / CHECK_KS), fabs((double) (i + 1) / CHECK_KS - d)));
+    }
+    report((prefix + "Kolmogorov-Smirnov statistic").c_str(), ks < 1.95 / sqrt((double) CHECK_KS), ks, 1.95 / sqrt((double) CHECK_KS));
+    
+    delete [] x;
+    
+}
+
+
+
+int main(void) {
+    
+    check_Known_Answers();
+    check_Streams();
+    check_Normals("Philox4x32-10 & Box-Muller", new_Normals);
+    check_Normals("Old rand & Kinderman-Monahan", old_Normals);
+    
+    if (failures > 0) {
+        cout << ">>> ERROR: " << failures << " checks of the RNG failed!" << endl;
+        return 1;
+    }
+    
+    cout << "All checks of the RNG passed." << endl;
+    
+    return 0;
+    
+}
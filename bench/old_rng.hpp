@@ -0,0 +1,74 @@
+/********************************************************************************
+ *                                                                              *
+ *          Porting the Essential Dynamics/Molecular Dynamics method            *
+ *             for large-scale nucleic acid simulations to ARCHER               *
+ *                                                                              *
+ *                               Zhuowei Si                                     *
+ *              EPCC supervisors: Elena Breitmoser, Iain Bethune                *
+ *     External supervisor: Charlie Laughton (The University of Nottingham)     *
+ *                                                                              *
+ *                  MSc in High Performance Computing, EPCC                     *
+ *                       The University of Edinburgh                            *
+ *                                                                              *
+ *******************************************************************************/
+
+/**
+ * File:  old_rng.hpp
+ * Brief: The generator of the random terms before the RNG class, kept as the
+ *        reference of bench_rng & check_rng: srand/rand reseeded at every call
+ *        and the Kinderman-Monahan ratio of uniforms (the time is no longer
+ *        in the seed, so the reference is reproducible)
+ */
+
+#ifndef old_rng_hpp
+#define old_rng_hpp
+
+#include <cstdlib>
+#include <cmath>
+
+
+/**
+ * Function:  Generate the normal numbers of a tetrad as the old calculate_Random_Terms
+ *
+ * Parameter: double* normals -> The normal numbers (output)
+ *            int count       -> The number of normal numbers
+ *            int stream      -> The stream (not used, the seed changes at every call)
+ *            int step        -> The step (not used)
+ *
+ * Return:    None
+ */
+static void old_Normals(double* normals, int count, int stream, int step) {
+    
+    static unsigned int RNG_Seed = 13579;
+    double s = 0.449871, t = -0.386595, a = 0.19600, b = 0.25472;
+    double half = 0.5, r1 = 0.27597, r2 = 0.27846, u, v, x, y, q;
+    
+    // Set the seed for random number generator (rank 0)
+    srand(RNG_Seed++);
+    if (RNG_Seed > 50000000) RNG_Seed = 13579;
+    
+    for (int i = 0; i < count; i++) {
+        
+        // Generate P = (u,v) uniform in rectangle enclosing acceptance region
+        while (1) {
+            
+            u = (double)(rand()/(double)RAND_MAX);
+            v = (double)(rand()/(double)RAND_MAX);
+            v = 1.7156 * (v - half);
+            
+            x = u - s;
+            y = fabs(v) - t;
+            q = x*x + y * (a*y - b*x);
+            
+            if (q < r1) { break; }    // Accept P if inside inner ellipse
+            if (q > r2) { continue; } // Reject P if outside outer ellipse
+            if (v*v < -4.0 * log(u) * (u*u)) { break; } // Reject P if outside region
+        }
+        
+        // Return ratio of P's coordinates as the normal deviate
+        normals[i] = v/u;
+    }
+    
+}
+
+#endif
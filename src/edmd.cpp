@@ -40,6 +40,7 @@ EDMD::EDMD(void) {
     mole_Cutoff = 30.0;
     atom_Cutoff = 10.0;
     mole_Least  =  5.0;
+    gamfac      =  1.0;
 }
 
 
@@ -61,15 +62,84 @@ void EDMD::initialise(double _dt, double _gamma, double _tautp, double _temperat
 
 
 
-void EDMD::calculate_ED_Forces(Tetrad* tetrad) {
+void EDMD::initialise_Constants(Tetrad* tetrad, int num_Tetrads) {
     
     int i, j;
-    double rotmat[9], v[3];
+    
+    // Velocity scale factor, gamfac = 0.9960 when gamma = 2.0
+    gamfac = 1.0 / (1.0 + gamma * dt);
+    
+    for (i = 0; i < num_Tetrads; i++) {
+        
+        // Noise factors, sum(noise_Factors) = 3594.75 when gmma = 2.0
+        for (j = 0; j < 3 * tetrad[i].num_Atoms; j++) {
+            tetrad[i].noise_Factors[j] = sqrt(2.0 * gamma * scaled * tetrad[i].masses[j] / dt);
+            tetrad[i].inv_Masses[j]    = 1.0 / tetrad[i].masses[j];
+        }
+        
+        for (j = 0; j < tetrad[i].num_Evecs; j++) {
+            tetrad[i].ED_Factors[j] = scaled / tetrad[i].eigenvalues[j];
+        }
+        
+        initialise_PC_Factors(&tetrad[i]);
+    }
+    
+}
+
+
+
+void EDMD::initialise_PC_Factors(Tetrad* tetrad) {
+    
+    int i, j, k, l, N = tetrad->num_Atoms, E = tetrad->num_Evecs;
+    double * chol = tetrad->pc_Factors, * com_Evecs = chol + E * (E + 1) / 2, * com_Avg = com_Evecs + 3 * E;
+    double sum, s, mass = 0.0;
+    
+    // The covariance of the random accelerations projected on the eigenvectors, the
+    // sum of e_j e_l (noise / mass)^2 over the coordinates (the rotation of the frame
+    // does not change it, the 3 coordinates of an atom have the same mass), and its
+    // Cholesky factor L (row by row, C = L L^T)
+    for (j = 0; j < E; j++) {
+        for (l = 0; l <= j; l++) {
+            for (sum = 0.0, i = 0; i < 3 * N; i++) {
+                s = tetrad->noise_Factors[i] * tetrad->inv_Masses[i];
+                sum += tetrad->eigenvectors[j][i] * tetrad->eigenvectors[l][i] * s * s;
+            }
+            for (k = 0; k < l; k++) { sum -= chol[j * (j + 1) / 2 + k] * chol[l * (l + 1) / 2 + k]; }
+            if (l == j) {
+                chol[j * (j + 1) / 2 + l] = (sum > 0.0) ? sqrt(sum) : 0.0;
+            } else {
+                s = chol[l * (l + 1) / 2 + l];
+                chol[j * (j + 1) / 2 + l] = (s > 0.0) ? sum / s : 0.0;
+            }
+        }
+    }
+    
+    // The centre of mass of the eigenvectors & of the average structure (contiguous),
+    // and the mass of the tetrad
+    for (k = 0; k < 3 * E + 3; k++) { com_Evecs[k] = 0.0; }
+    for (i = 0; i < N; i++) {
+        for (k = 0; k < 3; k++) {
+            for (j = 0; j < E; j++) { com_Evecs[3*j+k] += tetrad->masses[3*i] * tetrad->eigenvectors[j][3*i+k]; }
+            com_Avg[k] += tetrad->masses[3*i] * tetrad->avg[3*i+k];
+        }
+        mass += tetrad->masses[3 * i];
+    }
+    for (k = 0; k < 3 * E + 3; k++) { com_Evecs[k] /= mass; }
+    com_Avg[3] = mass;
+    
+}
+
+
+
+void EDMD::calculate_ED_Forces(Tetrad* tetrad, int energies) {
+    
+    int i, j, k;
+    double rotmat[9], v[3], c[3], f[3];
     
     // Allocate memory for temp arrays
     double * temp_Crds = new double [3 * tetrad->num_Atoms];
-    double * proj      = new double [tetrad->num_Evecs];
-    double ** temp_Frs = Array::allocate_2D_Double_Array(tetrad->num_Atoms, 3);
+    double * proj      = new double [2 * tetrad->num_Evecs];
+    double * proj_Frs  = proj + tetrad->num_Evecs;
     double ** avg_Crds = Array::allocate_2D_Double_Array(3, tetrad->num_Atoms);
     double ** crds     = Array::allocate_2D_Double_Array(3, tetrad->num_Atoms);
     
@@ -84,17 +154,15 @@ void EDMD::calculate_ED_Forces(Tetrad* tetrad) {
         crds[2][i] = tetrad->coordinates[3*i+2];
     }
     
-    // Step 1: rotate x into the pcz frame of reference & remove average structure
+    // Step 1: rotate x into the pcz frame of reference & remove average structure,
+    // and calculate the offset vector of tetrads in the same loop (with the original
+    // coordinates, as the QCP functions centre the copies)
     CalcRMSDRotationalMatrix((double **) avg_Crds, (double **) crds, tetrad->num_Atoms, rotmat, NULL); // Call QCP functions
-    for (i = 0; i < tetrad->num_Atoms; i++) {
+    for (v[0] = v[1] = v[2] = 0.0, i = 0; i < tetrad->num_Atoms; i++) {
         temp_Crds[3 * i] = rotmat[0] * crds[0][i] + rotmat[1] * crds[1][i] + rotmat[2] * crds[2][i] - avg_Crds[0][i];
         temp_Crds[3*i+1] = rotmat[3] * crds[0][i] + rotmat[4] * crds[1][i] + rotmat[5] * crds[2][i] - avg_Crds[1][i];
         temp_Crds[3*i+2] = rotmat[6] * crds[0][i] + rotmat[7] * crds[1][i] + rotmat[8] * crds[2][i]  - avg_Crds[2][i];
         
-    }
-    
-    // Calculate the offset vector of tetrads
-    for (v[0] = v[1] = v[2] = 0.0, i = 0; i < tetrad->num_Atoms; i++) {
         v[0] += (tetrad->avg[3 * i] - (rotmat[0] * tetrad->coordinates[3*i] + rotmat[1] * tetrad->coordinates[3*i+1] + rotmat[2] * tetrad->coordinates[3*i+2]));
         v[1] += (tetrad->avg[3*i+1] - (rotmat[3] * tetrad->coordinates[3*i] + rotmat[4] * tetrad->coordinates[3*i+1] + rotmat[5] * tetrad->coordinates[3*i+2]));
         v[2] += (tetrad->avg[3*i+2] - (rotmat[6] * tetrad->coordinates[3*i] + rotmat[7] * tetrad->coordinates[3*i+1] + rotmat[8] * tetrad->coordinates[3*i+2]));
@@ -109,55 +177,50 @@ void EDMD::calculate_ED_Forces(Tetrad* tetrad) {
         }
     }
     
-    // Step 3 & Step 4 done in the same loop
-    for (i = 0; i < 3 * tetrad->num_Atoms; i++) {
-        tetrad->ED_Forces[i] = 0.0; temp_Crds[i] = tetrad->avg[i];
+    // The ED force of the projection on each eigenvector, and Step 7: calculate the
+    // 'potential energy' (in units of kT), stroed in last entry of the ED force array
+    // (only when the energies are output)
+    for (i = 0; i < tetrad->num_Evecs; i++) {
+        proj_Frs[i] = proj[i] * tetrad->ED_Factors[i];
     }
-    
-    for (i = 0; i < 3 * tetrad->num_Atoms; i++) {
-        for (j = 0; j < tetrad->num_Evecs; j++) {
-            // Step 3: re-embed the input coordinates in PC space - a sort of 'shake' procedure.
-            //         Ideally this step is not needed, as stuff above should ensure all moves
-            //         remain in PC subspace...
-            temp_Crds[i] += tetrad->eigenvectors[j][i] * proj[j];
-            
-            // Step 4: calculate ED forces
-            tetrad->ED_Forces[i] -= (tetrad->eigenvectors[j][i] * proj[j] * scaled / tetrad->eigenvalues[j]);
+    if (energies) {
+        tetrad->ED_Forces[3 * tetrad->num_Atoms] = 0.0;
+        for (i = 0; i < tetrad->num_Evecs; i++) {
+            tetrad->ED_Forces[3 * tetrad->num_Atoms] += proj[i] * proj_Frs[i];
         }
+        tetrad->ED_Forces[3 * tetrad->num_Atoms] *= 0.5; // ED Energy
     }
     
-    // Step 5 & Step 6 done in a single loop
+    // Step 3 to Step 6 done in a single loop over atoms (the 3 components of an atom
+    // are rotated together)
     for (i = 0; i < tetrad->num_Atoms; i++) {
         
+        for (k = 0; k < 3; k++) {
+            c[k] = tetrad->avg[3 * i + k]; f[k] = 0.0;
+            for (j = 0; j < tetrad->num_Evecs; j++) {
+                // Step 3: re-embed the input coordinates in PC space - a sort of 'shake' procedure.
+                //         Ideally this step is not needed, as stuff above should ensure all moves
+                //         remain in PC subspace...
+                c[k] += tetrad->eigenvectors[j][3 * i + k] * proj[j];
+                
+                // Step 4: calculate ED forces
+                f[k] -= tetrad->eigenvectors[j][3 * i + k] * proj_Frs[j];
+            }
+        }
+        
         // Step 5: rotate 'shaken' coordinates back into right frame
-        temp_Crds[3*i] -= v[0]; temp_Crds[3*i+1] -= v[1]; temp_Crds[3*i+2] -= v[2];
-        tetrad->coordinates[3 * i] = rotmat[0] * temp_Crds[3*i] + rotmat[3] * temp_Crds[3*i+1] + rotmat[6] * temp_Crds[3*i+2];
-        tetrad->coordinates[3*i+1] = rotmat[1] * temp_Crds[3*i] + rotmat[4] * temp_Crds[3*i+1] + rotmat[7] * temp_Crds[3*i+2];
-        tetrad->coordinates[3*i+2] = rotmat[2] * temp_Crds[3*i] + rotmat[5] * temp_Crds[3*i+1] + rotmat[8] * temp_Crds[3*i+2];
+        c[0] -= v[0]; c[1] -= v[1]; c[2] -= v[2];
+        tetrad->coordinates[3 * i] = rotmat[0] * c[0] + rotmat[3] * c[1] + rotmat[6] * c[2];
+        tetrad->coordinates[3*i+1] = rotmat[1] * c[0] + rotmat[4] * c[1] + rotmat[7] * c[2];
+        tetrad->coordinates[3*i+2] = rotmat[2] * c[0] + rotmat[5] * c[1] + rotmat[8] * c[2];
         
         // Step 6: rotate forces back to original orientation of coordinates
-        temp_Frs[i][0] = rotmat[0] * tetrad->ED_Forces[3*i] + rotmat[3] * tetrad->ED_Forces[3*i+1] + rotmat[6] * tetrad->ED_Forces[3*i+2];
-        temp_Frs[i][1] = rotmat[1] * tetrad->ED_Forces[3*i] + rotmat[4] * tetrad->ED_Forces[3*i+1] + rotmat[7] * tetrad->ED_Forces[3*i+2];
-        temp_Frs[i][2] = rotmat[2] * tetrad->ED_Forces[3*i] + rotmat[5] * tetrad->ED_Forces[3*i+1] + rotmat[8] * tetrad->ED_Forces[3*i+2];
-
-    }
-    
-    // Assign the ED forces from the temporary arrays to tetrads
-    for (i = 0; i < tetrad->num_Atoms; i++) {
-        tetrad->ED_Forces[3 * i] = temp_Frs[i][0];
-        tetrad->ED_Forces[3*i+1] = temp_Frs[i][1];
-        tetrad->ED_Forces[3*i+2] = temp_Frs[i][2];
-    }
-
-    // Step 7: calculate the 'potential energy' (in units of kT), stroed in last entry of the ED force array of tetrad
-    tetrad->ED_Forces[3 * tetrad->num_Atoms] = 0.0;
-    for (i = 0; i < tetrad->num_Evecs; i++) {
-        tetrad->ED_Forces[3 * tetrad->num_Atoms] += (proj[i] * proj[i] / tetrad->eigenvalues[i]);
+        tetrad->ED_Forces[3 * i] = rotmat[0] * f[0] + rotmat[3] * f[1] + rotmat[6] * f[2];
+        tetrad->ED_Forces[3*i+1] = rotmat[1] * f[0] + rotmat[4] * f[1] + rotmat[7] * f[2];
+        tetrad->ED_Forces[3*i+2] = rotmat[2] * f[0] + rotmat[5] * f[1] + rotmat[8] * f[2];
     }
-    tetrad->ED_Forces[3 * tetrad->num_Atoms] *= 0.5 * scaled; // ED Energy
     
     // Deallocate memory of temp arrays
-    Array::deallocate_2D_Double_Array(temp_Frs);
     Array::deallocate_2D_Double_Array(avg_Crds);
     Array::deallocate_2D_Double_Array(crds);
     delete [] temp_Crds;
@@ -167,69 +230,20 @@ void EDMD::calculate_ED_Forces(Tetrad* tetrad) {
 
 
 
-void EDMD::calculate_Random_Terms(Tetrad* tetrad, int rank) {
-    
-    int i;
-    static unsigned int RNG_Seed = 13579;
-    double random, s = 0.449871, t = -0.386595, a = 0.19600, b = 0.25472;
-    double half = 0.5, r1 = 0.27597, r2 = 0.27846, u, v, x, y, q;
-    double * noise_Factor = new double[3 * tetrad->num_Atoms];
-
-    // Set the seed for random number generator
-    srand((unsigned)((RNG_Seed++) + rank * rank * rank + time(NULL)));
-    if (RNG_Seed > 50000000) RNG_Seed = 13579;
-    
-    // Noise factors, sum(noise_Factor) = 3594.75 when gmma = 2.0
-    for (i = 0; i < 3 * tetrad->num_Atoms; i++) {
-        noise_Factor[i] = sqrt(2.0 * gamma * scaled * tetrad->masses[i] / dt);
-        tetrad->random_Terms[i] = 0.0;
-    }
+void EDMD::calculate_Random_Terms(Tetrad* tetrad, int index, int step) {
     
-    // Calculate random terms;
-    for (i = 0; i < 3 * tetrad->num_Atoms; i++) {
-        /*
-         ! Adapted from the following Fortran 77 code
-         !      ALGORITHM 712, COLLECTED ALGORITHMS FROM ACM.
-         !      THIS WORK PUBLISHED IN TRANSACTIONS ON MATHEMATICAL SOFTWARE,
-         !      VOL. 18, NO. 4, DECEMBER, 1992, PP. 434-435.
-         
-         !  The function returns a normally distributed pseudo-random
-         !  number with zero mean and unit variance.
-         
-         !  The algorithm uses the ratio of uniforms method of A.J. Kinderman
-         !  and J.F. Monahan augmented with quadratic bounding curves.
-         */
-        {
-            // Generate P = (u,v) uniform in rectangle enclosing acceptance region
-            while (1) {
-                
-                u = (double)(rand()/(double)RAND_MAX);
-                v = (double)(rand()/(double)RAND_MAX);
-                v = 1.7156 * (v - half);
-                
-                x = u - s;
-                y = abs(v) - t;
-                q = x*x + y * (a*y - b*x);
-                
-                if (q < r1) { break; }    // Accept P if inside inner ellipse
-                if (q > r2) { continue; } // Reject P if outside outer ellipse
-                if (v*v < -4.0 * log(u) * (u*u)) { break; } // Reject P if outside region
-            }
-            
-            // Return ratio of P's coordinates as the normal deviate
-            random = v/u;
-        }
-        
-        tetrad->random_Terms[i] = random * noise_Factor[i];
+    // Calculate random terms (the normal random numbers of the tetrad at the step,
+    // scaled by the noise factors)
+    rng.generate_Normals(tetrad->random_Terms, 3 * tetrad->num_Atoms, index, step);
+    for (int i = 0; i < 3 * tetrad->num_Atoms; i++) {
+        tetrad->random_Terms[i] *= tetrad->noise_Factors[i];
     }
     
-    delete []noise_Factor;
-    
 }
 
 
 
-void EDMD::calculate_NB_Forces(Tetrad* t1, Tetrad* t2) {
+void EDMD::calculate_NB_Forces(Tetrad* t1, Tetrad* t2, int energies) {
     
     int i, j;
     double dx, dy, dz, sqdist;
@@ -261,8 +275,10 @@ void EDMD::calculate_NB_Forces(Tetrad* t1, Tetrad* t2) {
                 q = t1->abq[3*i+2] * t2->abq[3*j+2];
                 
                 // NB Energy & Electrostatic Energy
-                t1->NB_Forces[3 * t1->num_Atoms]     += 0.25 * krep * a * a;
-                t1->NB_Forces[3 * t1->num_Atoms + 1] += 0.5 * qfac * q * sqdist;
+                if (energies) {
+                    t1->NB_Forces[3 * t1->num_Atoms]     += 0.25 * krep * a * a;
+                    t1->NB_Forces[3 * t1->num_Atoms + 1] += 0.5 * qfac * q * sqdist;
+                }
                 
                 // NB forces
                 pair_Force = -2.0 * krep * a - 2.0 * qfac * q / (sqdist * sqdist);
@@ -286,17 +302,44 @@ void EDMD::calculate_NB_Forces(Tetrad* t1, Tetrad* t2) {
 
 
 
+void EDMD::assign_NB_Forces(Tetrad* tetrad, double* NB_Forces) {
+    
+    int j;
+    
+    for (j = 0; j < 3 * tetrad->num_Atoms; j++) {
+        
+        // Clip the NB forces between -1.0 and 1.0
+        if (NB_Forces[j] < -1.0)  NB_Forces[j]  =  -1.0;
+        else if (NB_Forces[j] > 1.0) NB_Forces[j] = 1.0;
+        
+        // Assign NB forces to tetrads
+        tetrad->NB_Forces[j] = NB_Forces[j];
+        
+        // Clear the NB force array for next use
+        NB_Forces[j] = 0.0;
+        
+    }
+    
+    // NB energy & Electrostatic Energy
+    tetrad->NB_Forces[j]     = NB_Forces[j];
+    tetrad->NB_Forces[j + 1] = NB_Forces[j + 1];
+    
+    NB_Forces[j] = NB_Forces[j + 1] = 0.0;
+    
+}
+
+
+
 void EDMD::update_Velocities(Tetrad* tetrad) {
     
     int i;
     double kentic_Energy = 0.0;
     double target_KE; // The target kinetic energy
     double tscal;     // The Berendsen T-coupling factor
-    double gamfac = 1.0 / (1.0 + gamma * dt); // Velocity scale factor
     
     for (i = 0; i < 3 * tetrad->num_Atoms; i++) {
         // Simple Langevin dynamics, gamfac = 0.9960
-        tetrad->velocities[i] = (tetrad->velocities[i] + tetrad->ED_Forces[i] * dt + (tetrad->random_Terms[i] + tetrad->NB_Forces[i]) * dt / tetrad->masses[i]) * gamfac;
+        tetrad->velocities[i] = (tetrad->velocities[i] + tetrad->ED_Forces[i] * dt + (tetrad->random_Terms[i] + tetrad->NB_Forces[i]) * dt * tetrad->inv_Masses[i]) * gamfac;
 
         // Berendsen temperature control. Calculate the actual kentic energy
         kentic_Energy += 0.5 * tetrad->masses[i] * tetrad->velocities[i] * tetrad->velocities[i];
@@ -326,3 +369,357 @@ void EDMD::update_Coordinates(Tetrad* tetrad) {
     }
 }
 
+
+
+void EDMD::integrate_Tetrad(Tetrad* tetrad, double* NB_Forces) {
+    
+    int i, n = 3 * tetrad->num_Atoms;
+    double kentic_Energy = 0.0, nb_Force, target_KE, tscal;
+    
+    // Simple Langevin dynamics with the clipped NB forces, and the actual kentic
+    // energy of the Berendsen temperature control
+    for (i = 0; i < n; i++) {
+        nb_Force = max(-1.0, min(1.0, NB_Forces[i]));
+        tetrad->velocities[i] = (tetrad->velocities[i] + tetrad->ED_Forces[i] * dt + (tetrad->random_Terms[i] + nb_Force) * dt * tetrad->inv_Masses[i]) * gamfac;
+        kentic_Energy += 0.5 * tetrad->masses[i] * tetrad->velocities[i] * tetrad->velocities[i];
+    }
+    tetrad->NB_Forces[n]     = NB_Forces[n];
+    tetrad->NB_Forces[n + 1] = NB_Forces[n + 1];
+    
+    target_KE = 0.5 * scaled * 3 * tetrad->num_Atoms;
+    tscal = sqrt(1.0 + (dt/tautp) * ((target_KE/kentic_Energy) - 1.0));
+    
+    // Calculate temperature of tetrad
+    tetrad->temperature = kentic_Energy * 2 / (constants.Boltzmann * 3 * tetrad->num_Atoms);
+    tetrad->temperature *= tscal * tscal;
+    
+    // Scale the velocities & update the coordinates
+    for (i = 0; i < n; i++) {
+        tetrad->velocities[i]  *= tscal;
+        tetrad->coordinates[i] += tetrad->velocities[i] * dt;
+    }
+    
+}
+
+
+
+
+void EDMD::initialise_PC_State(Tetrad* tetrad) {
+    
+    int i, j, k, N = tetrad->num_Atoms, E = tetrad->num_Evecs;
+    double * amps = tetrad->pc_State, * rotmat = amps + E, * v = rotmat + 9;
+    double * amp_Vels = v + 3, * lin_Vel = amp_Vels + E, * ang_Vel = lin_Vel + 3;
+    double b[3], r[3], w[3], centre[3], inertia[9], momentum[3], m, mass = 0.0;
+    double * x = tetrad->coordinates, * vel = tetrad->velocities;
+    
+    double ** avg_Crds = Array::allocate_2D_Double_Array(3, N);
+    double ** crds     = Array::allocate_2D_Double_Array(3, N);
+    
+    for (i = 0; i < N; i++) {
+        for (k = 0; k < 3; k++) { avg_Crds[k][i] = tetrad->avg[3*i+k]; crds[k][i] = x[3*i+k]; }
+    }
+    
+    // The frame: fit the coordinates onto the average structure (as Step 1 of the
+    // ED forces), the offset vector, the centre of mass & the velocity of the centre
+    CalcRMSDRotationalMatrix((double **) avg_Crds, (double **) crds, N, rotmat, NULL);
+    for (k = 0; k < 3; k++) { v[k] = centre[k] = lin_Vel[k] = 0.0; }
+    for (i = 0; i < N; i++) {
+        m = tetrad->masses[3 * i];
+        for (k = 0; k < 3; k++) {
+            v[k] += tetrad->avg[3*i+k] - (rotmat[3*k] * x[3*i] + rotmat[3*k+1] * x[3*i+1] + rotmat[3*k+2] * x[3*i+2]);
+            centre[k]  += m * x[3*i+k];
+            lin_Vel[k] += m * vel[3*i+k];
+        }
+        mass += m;
+    }
+    for (k = 0; k < 3; k++) { v[k] /= N; centre[k] /= mass; lin_Vel[k] /= mass; }
+    
+    // The amplitudes: project the coordinates in the frame on the eigenvectors. The
+    // inertia & the angular momentum about the centre of mass
+    for (j = 0; j < E; j++) { amps[j] = amp_Vels[j] = 0.0; }
+    for (k = 0; k < 9; k++) { inertia[k] = 0.0; }
+    momentum[0] = momentum[1] = momentum[2] = 0.0;
+    for (i = 0; i < N; i++) {
+        for (k = 0; k < 3; k++) {
+            b[k] = rotmat[3*k] * x[3*i] + rotmat[3*k+1] * x[3*i+1] + rotmat[3*k+2] * x[3*i+2] + v[k] - tetrad->avg[3*i+k];
+            r[k] = x[3*i+k] - centre[k];
+            w[k] = vel[3*i+k] - lin_Vel[k];
+        }
+        for (j = 0; j < E; j++) {
+            amps[j] += tetrad->eigenvectors[j][3*i] * b[0] + tetrad->eigenvectors[j][3*i+1] * b[1] + tetrad->eigenvectors[j][3*i+2] * b[2];
+        }
+        
+        m = tetrad->masses[3 * i];
+        momentum[0] += m * (r[1] * w[2] - r[2] * w[1]);
+        momentum[1] += m * (r[2] * w[0] - r[0] * w[2]);
+        momentum[2] += m * (r[0] * w[1] - r[1] * w[0]);
+        add_Inertia(inertia, r, m);
+    }
+    
+    // The angular velocity of the best fit of the velocities about the centre
+    solve_3x3(inertia, momentum, ang_Vel);
+    
+    // The velocities of the amplitudes: project the internal velocities (without the
+    // motion of the frame) in the frame on the eigenvectors
+    for (i = 0; i < N; i++) {
+        for (k = 0; k < 3; k++) { r[k] = x[3*i+k] - centre[k]; }
+        w[0] = vel[3 * i] - lin_Vel[0] - (ang_Vel[1] * r[2] - ang_Vel[2] * r[1]);
+        w[1] = vel[3*i+1] - lin_Vel[1] - (ang_Vel[2] * r[0] - ang_Vel[0] * r[2]);
+        w[2] = vel[3*i+2] - lin_Vel[2] - (ang_Vel[0] * r[1] - ang_Vel[1] * r[0]);
+        for (k = 0; k < 3; k++) { b[k] = rotmat[3*k] * w[0] + rotmat[3*k+1] * w[1] + rotmat[3*k+2] * w[2]; }
+        for (j = 0; j < E; j++) {
+            amp_Vels[j] += tetrad->eigenvectors[j][3*i] * b[0] + tetrad->eigenvectors[j][3*i+1] * b[1] + tetrad->eigenvectors[j][3*i+2] * b[2];
+        }
+    }
+    
+    Array::deallocate_2D_Double_Array(avg_Crds);
+    Array::deallocate_2D_Double_Array(crds);
+    
+}
+
+
+
+void EDMD::reconstruct_Crds(Tetrad* tetrad) {
+    
+    int i, j, k, E = tetrad->num_Evecs;
+    double * amps = tetrad->pc_State, * rotmat = amps + E, * v = rotmat + 9, c[3];
+    
+    for (i = 0; i < tetrad->num_Atoms; i++) {
+        
+        // The structure of the amplitudes in the frame (as Step 3 of the ED forces)
+        for (k = 0; k < 3; k++) {
+            c[k] = tetrad->avg[3 * i + k] - v[k];
+            for (j = 0; j < E; j++) { c[k] += tetrad->eigenvectors[j][3 * i + k] * amps[j]; }
+        }
+        
+        // Rotate it back to the orientation of the coordinates (as Step 5)
+        tetrad->coordinates[3 * i] = rotmat[0] * c[0] + rotmat[3] * c[1] + rotmat[6] * c[2];
+        tetrad->coordinates[3*i+1] = rotmat[1] * c[0] + rotmat[4] * c[1] + rotmat[7] * c[2];
+        tetrad->coordinates[3*i+2] = rotmat[2] * c[0] + rotmat[5] * c[1] + rotmat[8] * c[2];
+    }
+    
+}
+
+
+
+void EDMD::reconstruct_Vels(Tetrad* tetrad) {
+    
+    int i, j, k, N = tetrad->num_Atoms, E = tetrad->num_Evecs;
+    double * rotmat = tetrad->pc_State + E, * amp_Vels = rotmat + PC_FRAME;
+    double * lin_Vel = amp_Vels + E, * ang_Vel = lin_Vel + 3, centre[3], r[3], w[3];
+    
+    // The centre of mass (the frame rotates about it)
+    centre_of_Mass(tetrad, centre);
+    
+    // The internal velocities rotated back, plus the velocities of the frame
+    for (i = 0; i < N; i++) {
+        for (k = 0; k < 3; k++) {
+            r[k] = tetrad->coordinates[3*i+k] - centre[k];
+            for (w[k] = 0.0, j = 0; j < E; j++) { w[k] += tetrad->eigenvectors[j][3*i+k] * amp_Vels[j]; }
+        }
+        tetrad->velocities[3 * i] = rotmat[0] * w[0] + rotmat[3] * w[1] + rotmat[6] * w[2] + lin_Vel[0] + ang_Vel[1] * r[2] - ang_Vel[2] * r[1];
+        tetrad->velocities[3*i+1] = rotmat[1] * w[0] + rotmat[4] * w[1] + rotmat[7] * w[2] + lin_Vel[1] + ang_Vel[2] * r[0] - ang_Vel[0] * r[2];
+        tetrad->velocities[3*i+2] = rotmat[2] * w[0] + rotmat[5] * w[1] + rotmat[8] * w[2] + lin_Vel[2] + ang_Vel[0] * r[1] - ang_Vel[1] * r[0];
+    }
+    
+}
+
+
+
+void EDMD::integrate_PC(Tetrad* tetrad, int index, int step, int nb_Step, int crds) {
+    
+    int i, j, k, N = tetrad->num_Atoms, E = tetrad->num_Evecs;
+    double * amps = tetrad->pc_State, * rotmat = amps + E, * v = rotmat + 9;
+    double * amp_Vels = v + 3, * lin_Vel = amp_Vels + E, * ang_Vel = lin_Vel + 3;
+    double * amp_NB = ang_Vel + 3, * NB_Force = amp_NB + E, * NB_Torque = NB_Force + 3, * body = NB_Torque + 3;
+    double * chol = tetrad->pc_Factors, mass = chol[E * (E + 7) / 2 + 3];
+    double a[3], b[3], r[3], d[3], centre[3], lin_Acc[3], ang_Acc[3], torque[3];
+    double inertia[9], L[9], Q[9], R[9], axis[3], theta, s, c, noise;
+    double kentic_Energy = 0.0, target_KE, tscal;
+    double * amp_Accs = new double [2 * E + 6], * normals = amp_Accs + E;
+    
+    centre_of_Mass(tetrad, centre);
+    
+    // The NB forces (fresh at the NB steps, the coordinates are the ones of the
+    // state) projected on the eigenvectors in the frame, and the force, the torque
+    // & the inertia of the frame about the centre of mass. They are held until the
+    // next NB step, as the NB forces of tetrads (the inertia in the frame, so it
+    // turns with the frame).
+    if (nb_Step) {
+        for (j = 0; j < E; j++) { amp_NB[j] = 0.0; }
+        for (k = 0; k < 3; k++) { NB_Force[k] = NB_Torque[k] = 0.0; }
+        for (k = 0; k < 9; k++) { inertia[k] = 0.0; }
+        for (i = 0; i < N; i++) {
+            for (k = 0; k < 3; k++) {
+                a[k] = tetrad->NB_Forces[3*i+k] * tetrad->inv_Masses[3*i+k];
+                r[k] = tetrad->coordinates[3*i+k] - centre[k];
+                NB_Force[k] += tetrad->NB_Forces[3*i+k];
+            }
+            for (k = 0; k < 3; k++) { b[k] = rotmat[3*k] * a[0] + rotmat[3*k+1] * a[1] + rotmat[3*k+2] * a[2]; }
+            for (j = 0; j < E; j++) {
+                amp_NB[j] += tetrad->eigenvectors[j][3*i] * b[0] + tetrad->eigenvectors[j][3*i+1] * b[1] + tetrad->eigenvectors[j][3*i+2] * b[2];
+            }
+            
+            NB_Torque[0] += r[1] * tetrad->NB_Forces[3*i+2] - r[2] * tetrad->NB_Forces[3*i+1];
+            NB_Torque[1] += r[2] * tetrad->NB_Forces[3 * i] - r[0] * tetrad->NB_Forces[3*i+2];
+            NB_Torque[2] += r[0] * tetrad->NB_Forces[3*i+1] - r[1] * tetrad->NB_Forces[3 * i];
+            add_Inertia(inertia, r, tetrad->masses[3 * i]);
+        }
+        
+        // The inertia in the frame, R I R^T
+        for (k = 0; k < 9; k++) {
+            for (body[k] = 0.0, i = 0; i < 9; i++) {
+                body[k] += rotmat[3 * (k / 3) + i / 3] * inertia[i] * rotmat[3 * (k % 3) + i % 3];
+            }
+        }
+    }
+    
+    // The inertia in the orientation of the coordinates, R^T I R, & its Cholesky factor
+    for (k = 0; k < 9; k++) {
+        for (inertia[k] = 0.0, i = 0; i < 9; i++) {
+            inertia[k] += rotmat[3 * (i / 3) + k / 3] * body[i] * rotmat[3 * (i % 3) + k % 3];
+        }
+    }
+    for (k = 0; k < 9; k++) { L[k] = 0.0; }
+    if (inertia[0] > 0.0) {
+        L[0] = sqrt(inertia[0]); L[3] = inertia[3] / L[0]; L[6] = inertia[6] / L[0];
+        s = inertia[4] - L[3] * L[3];
+        if (s > 0.0) {
+            L[4] = sqrt(s); L[7] = (inertia[7] - L[6] * L[3]) / L[4];
+            s = inertia[8] - L[6] * L[6] - L[7] * L[7];
+            L[8] = (s > 0.0) ? sqrt(s) : 0.0;
+        }
+    }
+    
+    // The random terms in the subspace: E + 6 normal random numbers of the tetrad at
+    // the step. The random accelerations of the amplitudes have the covariance of
+    // the projected noise factors (L L^T, see initialise_PC_Factors). The random
+    // force of the frame has the variance 2 gamma kT M / dt, and the random torque
+    // the covariance 2 gamma kT I / dt (the sums over the atoms of the noise factors).
+    rng.generate_Normals(normals, E + 6, index, step);
+    noise = sqrt(2.0 * gamma * scaled / dt);
+    
+    // The accelerations of the amplitudes: the ED forces (the projections are the
+    // amplitudes, no fit needed in the PC subspace) & the ED energy, the held NB
+    // forces & the random terms
+    tetrad->ED_Forces[3 * N] = 0.0;
+    for (j = 0; j < E; j++) {
+        amp_Accs[j] = -amps[j] * tetrad->ED_Factors[j];
+        tetrad->ED_Forces[3 * N] -= 0.5 * amps[j] * amp_Accs[j];
+        amp_Accs[j] += amp_NB[j];
+        for (k = 0; k <= j; k++) { amp_Accs[j] += chol[j * (j + 1) / 2 + k] * normals[k]; }
+    }
+    
+    // The accelerations of the frame
+        for (k = 0; k < 3; k++) {
+        lin_Acc[k] = (NB_Force[k] + noise * sqrt(mass) * normals[E + k]) / mass;
+        torque[k]  = NB_Torque[k] + noise * (L[3*k] * normals[E+3] + L[3*k+1] * normals[E+4] + L[3*k+2] * normals[E+5]);
+    }
+    solve_3x3(inertia, torque, ang_Acc);
+    
+    // Simple Langevin dynamics of the amplitudes & the frame, and the kentic energy
+    // of the Berendsen temperature control (the amplitudes with the mean mass of atoms)
+    for (j = 0; j < E; j++) {
+        amp_Vels[j] = (amp_Vels[j] + amp_Accs[j] * dt) * gamfac;
+        kentic_Energy += (mass / N) * amp_Vels[j] * amp_Vels[j];
+    }
+    for (k = 0; k < 3; k++) {
+        lin_Vel[k] = (lin_Vel[k] + lin_Acc[k] * dt) * gamfac;
+        ang_Vel[k] = (ang_Vel[k] + ang_Acc[k] * dt) * gamfac;
+        kentic_Energy += mass * lin_Vel[k] * lin_Vel[k];
+    }
+    for (k = 0; k < 9; k++) { kentic_Energy += ang_Vel[k / 3] * inertia[k] * ang_Vel[k % 3]; }
+    kentic_Energy *= 0.5;
+    
+    target_KE = 0.5 * scaled * (E + 6);
+    tscal = sqrt(1.0 + (dt/tautp) * ((target_KE/kentic_Energy) - 1.0));
+    
+    // Calculate temperature of tetrad
+    tetrad->temperature = kentic_Energy * 2 / (constants.Boltzmann * (E + 6));
+    tetrad->temperature *= tscal * tscal;
+    
+    // Scale the velocities & update the amplitudes
+    for (j = 0; j < E; j++) {
+        amp_Vels[j] *= tscal;
+        amps[j] += amp_Vels[j] * dt;
+    }
+    for (k = 0; k < 3; k++) { lin_Vel[k] *= tscal; ang_Vel[k] *= tscal; }
+    
+    // The rotation of the step about the axis of the angular velocity (Rodrigues'
+    // formula), Q = I + sin(theta) K + (1 - cos(theta)) K^2
+    theta = sqrt(ang_Vel[0] * ang_Vel[0] + ang_Vel[1] * ang_Vel[1] + ang_Vel[2] * ang_Vel[2]) * dt;
+    for (k = 0; k < 9; k++) { Q[k] = (k % 4 == 0) ? 1.0 : 0.0; }
+    if (theta > 1e-12) {
+        for (k = 0; k < 3; k++) { axis[k] = ang_Vel[k] * dt / theta; }
+        s = sin(theta); c = 1.0 - cos(theta);
+        for (k = 0; k < 9; k++) { Q[k] += c * axis[k / 3] * axis[k % 3]; }
+        Q[0] -= c; Q[4] -= c; Q[8] -= c;
+        Q[1] -= s * axis[2]; Q[2] += s * axis[1]; Q[5] -= s * axis[0];
+        Q[3] += s * axis[2]; Q[6] -= s * axis[1]; Q[7] += s * axis[0];
+    }
+    
+    // Rotate the frame about the centre of mass & translate it, the coordinates
+    // R^T (c - v) move to Q (x - centre) + centre + lin_Vel * dt, so R' = R Q^T and
+    // v' = v - R' d with d = centre - Q centre + lin_Vel * dt
+    for (k = 0; k < 9; k++) {
+        R[k] = rotmat[3 * (k / 3)] * Q[3 * (k % 3)] + rotmat[3 * (k / 3) + 1] * Q[3 * (k % 3) + 1] + rotmat[3 * (k / 3) + 2] * Q[3 * (k % 3) + 2];
+    }
+    for (k = 0; k < 3; k++) {
+        d[k] = centre[k] - (Q[3*k] * centre[0] + Q[3*k+1] * centre[1] + Q[3*k+2] * centre[2]) + lin_Vel[k] * dt;
+    }
+    for (k = 0; k < 3; k++) { v[k] -= R[3*k] * d[0] + R[3*k+1] * d[1] + R[3*k+2] * d[2]; }
+    for (k = 0; k < 9; k++) { rotmat[k] = R[k]; }
+    
+    // The coordinates only for the next NB step (& the output)
+    if (crds) reconstruct_Crds(tetrad);
+    
+    delete [] amp_Accs;
+    
+}
+
+
+
+void EDMD::centre_of_Mass(Tetrad* tetrad, double* centre) {
+    
+    int j, k, E = tetrad->num_Evecs;
+    double * amps = tetrad->pc_State, * rotmat = amps + E, * v = rotmat + 9;
+    double * com_Evecs = tetrad->pc_Factors + E * (E + 1) / 2, * com_Avg = com_Evecs + 3 * E, c[3];
+    
+    // The centre of mass of the structure in the frame, rotated back (as reconstruct_Crds)
+    for (k = 0; k < 3; k++) {
+        c[k] = com_Avg[k] - v[k];
+        for (j = 0; j < E; j++) { c[k] += com_Evecs[3*j+k] * amps[j]; }
+    }
+    centre[0] = rotmat[0] * c[0] + rotmat[3] * c[1] + rotmat[6] * c[2];
+    centre[1] = rotmat[1] * c[0] + rotmat[4] * c[1] + rotmat[7] * c[2];
+    centre[2] = rotmat[2] * c[0] + rotmat[5] * c[1] + rotmat[8] * c[2];
+    
+}
+
+
+
+void EDMD::add_Inertia(double* inertia, double* r, double m) {
+    
+    double r2 = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+    
+    for (int k = 0; k < 9; k++) { inertia[k] -= m * r[k / 3] * r[k % 3]; }
+    inertia[0] += m * r2;
+    inertia[4] += m * r2;
+    inertia[8] += m * r2;
+    
+}
+
+
+
+void EDMD::solve_3x3(double* matrix, double* b, double* x) {
+    
+    double * m = matrix;
+    double det = m[0] * (m[4] * m[8] - m[5] * m[7]) - m[1] * (m[3] * m[8] - m[5] * m[6]) + m[2] * (m[3] * m[7] - m[4] * m[6]);
+    
+    if (fabs(det) < 1e-12) { x[0] = x[1] = x[2] = 0.0; return; }
+    
+    x[0] = (b[0] * (m[4] * m[8] - m[5] * m[7]) - m[1] * (b[1] * m[8] - m[5] * b[2]) + m[2] * (b[1] * m[7] - m[4] * b[2])) / det;
+    x[1] = (m[0] * (b[1] * m[8] - m[5] * b[2]) - b[0] * (m[3] * m[8] - m[5] * m[6]) + m[2] * (m[3] * b[2] - b[1] * m[6])) / det;
+    x[2] = (m[0] * (m[4] * b[2] - b[1] * m[7]) - m[1] * (m[3] * b[2] - b[1] * m[6]) + b[0] * (m[3] * m[7] - m[4] * m[6])) / det;
+    
+}
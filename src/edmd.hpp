@@ -24,11 +24,14 @@
 #include <cstdlib>
 #include <cmath>
 #include <ctime>
+#ifndef STANDALONE
 #include "mpi.h"
+#endif
 
 #include "./qcprot/qcprot.h"
 #include "array.hpp"
 #include "tetrad.hpp"
+#include "rng.hpp"
 
 using namespace std;
 
@@ -73,6 +76,10 @@ public:
     
     double mole_Least;   // Molecules farther than the mole_Least won't have NB forces
     
+    double gamfac;       // The velocity scale factor of Langevin dynamics, 1/(1+gamma*dt)
+    
+    RNG rng;             // The counter-based random number generator of the random terms
+    
 public:
     
     /**
@@ -109,45 +116,69 @@ public:
      */
     void initialise(double _dt, double _gamma, double _tautp, double _temperature, double _scaled, double _mole_Cutoff, double _atom_Cutoff, double _mole_Least);
     
+    /**
+     * Function:  Calculate the integration constants of tetrads (the noise factors,
+     *            the inverse masses, the ED force factors & the constants of the PC
+     *            subspace) and the velocity scale factor. Call it again after any
+     *            change of dt, gamma or temperature.
+     *
+     * Parameter: Tetrad* tetrad   -> The tetrad array (with the parameters)
+     *            int num_Tetrads  -> The number of tetrads
+     *
+     * Return:    None
+     */
+    void initialise_Constants(Tetrad* tetrad, int num_Tetrads);
+    
     /**
      * Function:  Calculate ED forces of tetrad
      *
      * Parameter: Tetrad* tetrad -> The tetrad whose ED forces to be calculated
+     *            int energies   -> Calculate the ED energy as well (0: no, 1: yes)
      *
      * Return:    None, the ED forces are stored in the tetrad itself
      */
-    void calculate_ED_Forces(Tetrad* tetrad);
+    void calculate_ED_Forces(Tetrad* tetrad, int energies);
     
     /**
      * Function:  Generate the Gaussian stochastic term. Assuming unitless.
      *
-     *            Part of code is adapted from the following Fortran 77 code
-     *            !      ALGORITHM 712, COLLECTED ALGORITHMS FROM ACM.
-     *            !      THIS WORK PUBLISHED IN TRANSACTIONS ON MATHEMATICAL SOFTWARE,
-     *            !      VOL. 18, NO. 4, DECEMBER, 1992, PP. 434-435.
-     *
-     *            !  The function returns a normally distributed pseudo-random
-     *            !  number with zero mean and unit variance.
-     *
-     *            !  The algorithm uses the ratio of uniforms method of A.J. Kinderman
-     *            !  and J.F. Monahan augmented with quadratic bounding curves.
+     *            The normal random numbers of the whole tetrad are generated at once
+     *            by the counter-based RNG, in the stream of the tetrad at the step,
+     *            so the random terms do not depend on the process (or the thread)
+     *            which generates them. They are scaled by the noise factors of the
+     *            tetrad (see initialise_Constants).
      *
      * Parameter: Tetrad* tetrad -> The tetrad whose random terms to be calculated
-     *            int rank       -> The rank of worker used as the random seed
+     *            int index      -> The index of the tetrad
+     *            int step       -> The step of the simulation
      *
      * Return:    None
      */
-    void calculate_Random_Terms(Tetrad* tetrad, int rank);
+    void calculate_Random_Terms(Tetrad* tetrad, int index, int step);
     
     /**
      * Function:  Calculate the NB forces between two interacting tetrads
      *
-     * Parameter: Tetrad* t1 -> The tetrad whose NB forces to be calculated
-     *            Tetrad* t2 -> The tetrad whose NB forces to be calculated
+     * Parameter: Tetrad* t1     -> The tetrad whose NB forces to be calculated
+     *            Tetrad* t2     -> The tetrad whose NB forces to be calculated
+     *            int energies   -> Calculate the NB & electrostatic energies as well
+     *                              (0: no, the energies are 0, 1: yes)
      *
      * Return:    None, the NB forces are stored in two tetrads
      */
-    void calculate_NB_Forces(Tetrad* t1, Tetrad* t2);
+    void calculate_NB_Forces(Tetrad* t1, Tetrad* t2, int energies);
+    
+    /**
+     * Function:  Clip the (summed) NB forces of a tetrad between -1.0 and 1.0, assign
+     *            them & the NB & electrostatic energies to the tetrad, and clear them
+     *            for the next sum
+     *
+     * Parameter: Tetrad* tetrad    -> The tetrad whose NB forces to be assigned
+     *            double* NB_Forces -> The summed NB forces of the tetrad (0 on return)
+     *
+     * Return:    None
+     */
+    void assign_NB_Forces(Tetrad* tetrad, double* NB_Forces);
     
     /**
      * Function:  Update the velocities of tetrad (Berendsen temperature control applied)
@@ -167,6 +198,124 @@ public:
      */
     void update_Coordinates(Tetrad* tetrad);
     
+    /**
+     * Function:  Integrate a tetrad by a step in two passes: the Langevin update of
+     *            the velocities (with the kinetic energy), then the Berendsen scaling
+     *            fused with the update of the coordinates. The same arithmetic as
+     *            update_Velocities & update_Coordinates, with the random terms
+     *            already generated.
+     *
+     * Parameter: Tetrad* tetrad    -> The tetrad to be integrated
+     *            double* NB_Forces -> The (summed) NB forces of the tetrad, clipped
+     *                                 between -1.0 and 1.0 here. The NB & electrostatic
+     *                                 energies are copied into the tetrad
+     *
+     * Return:    None
+     */
+    void integrate_Tetrad(Tetrad* tetrad, double* NB_Forces);
+    
+    /**
+     * Function:  Initialise the state of a tetrad in the PC subspace from its
+     *            coordinates & velocities. The coordinates are fitted onto the
+     *            average structure (the frame) and projected on the eigenvectors (the
+     *            amplitudes). The velocities are split into the linear & angular
+     *            velocities of the frame and the velocities of the amplitudes.
+     *
+     * Parameter: Tetrad* tetrad -> The tetrad whose PC state to be initialised
+     *
+     * Return:    None
+     */
+    void initialise_PC_State(Tetrad* tetrad);
+    
+    /**
+     * Function:  Reconstruct the coordinates of a tetrad from its PC state
+     *
+     * Parameter: Tetrad* tetrad -> The tetrad whose coordinates to be reconstructed
+     *
+     * Return:    None
+     */
+    void reconstruct_Crds(Tetrad* tetrad);
+    
+    /**
+     * Function:  Reconstruct the velocities of a tetrad from its PC state (with the
+     *            reconstructed coordinates)
+     *
+     * Parameter: Tetrad* tetrad -> The tetrad whose velocities to be reconstructed
+     *
+     * Return:    None
+     */
+    void reconstruct_Vels(Tetrad* tetrad);
+    
+    /**
+     * Function:  Integrate a tetrad by a step in the PC subspace. The ED forces act
+     *            on the amplitudes directly. The NB forces are projected on the
+     *            eigenvectors and on the translation & rotation of the frame (the
+     *            torque & the inertia about the centre of mass) at the NB steps, and
+     *            held in between. The num_Evecs + 6 random terms are drawn in the
+     *            subspace. The Berendsen temperature control applies to the kentic
+     *            energy of the num_Evecs + 6 degrees of freedom (the amplitudes with
+     *            the mean mass of atoms).
+     *
+     * Parameter: Tetrad* tetrad -> The tetrad to be integrated (with the clipped NB forces)
+     *            int index      -> The index of the tetrad (the stream of the random terms)
+     *            int step       -> The step of the simulation
+     *            int nb_Step    -> The NB forces are fresh (the coordinates are the ones
+     *                              of the state), project them (0: no, 1: yes)
+     *            int crds       -> Reconstruct the coordinates after the step, for the
+     *                              next NB step & the output (0: no, 1: yes)
+     *
+     * Return:    None
+     */
+    void integrate_PC(Tetrad* tetrad, int index, int step, int nb_Step, int crds);
+    
+private:
+    
+    /**
+     * Function:  Calculate the constants of a tetrad in the PC subspace: the Cholesky
+     *            factor of the covariance of the random accelerations projected on
+     *            the eigenvectors, the centre of mass of the eigenvectors & of the
+     *            average structure, and the mass of the tetrad
+     *
+     * Parameter: Tetrad* tetrad -> The tetrad (with the noise factors & inverse masses)
+     *
+     * Return:    None
+     */
+    void initialise_PC_Factors(Tetrad* tetrad);
+    
+    /**
+     * Function:  Calculate the centre of mass of a tetrad from its PC state (without
+     *            the coordinates)
+     *
+     * Parameter: Tetrad* tetrad -> The tetrad
+     *            double* centre -> The centre of mass (output)
+     *
+     * Return:    None
+     */
+    void centre_of_Mass(Tetrad* tetrad, double* centre);
+    
+    /**
+     * Function:  Add an atom to an inertia tensor
+     *
+     * Parameter: double* inertia -> The inertia tensor (row-major, 9 elements)
+     *            double* r       -> The position of the atom about the centre
+     *            double m        -> The mass of the atom
+     *
+     * Return:    None
+     */
+    static void add_Inertia(double* inertia, double* r, double m);
+    
+    /**
+     * Function:  Solve a 3x3 linear system (Cramer's rule), the solution is 0 when
+     *            the matrix is singular (e.g. the inertia of collinear atoms)
+     *
+     * Parameter: double* matrix -> The matrix (row-major, 9 elements)
+     *            double* b      -> The right-hand side
+     *            double* x      -> The solution
+     *
+     * Return:    None
+     */
+    static void solve_3x3(double* matrix, double* b, double* x);
+    
 };
 
 #endif /* parameters_hpp */
@@ -30,6 +30,33 @@ IO::IO(void) {
     ntwt   = 100;
     ntpr   = 1000;
     
+    nb_Schedule = 0;
+    nb_Chunk    = 16;
+    
+    load_Balance = 0;
+    lb_Damping   = 0.5;
+    
+    nb_Partition = 0;
+    master_Share = 0.0;
+    ed_Workers   = 0;
+    nb_Reduce    = 0;
+    nb_Overlap   = 0;
+    integration  = 0;
+    crd_Exchange = 0;
+    shm_Node     = 0;
+    omp_Threads  = 0;
+    crd_Precision = 0;
+    crd_Validate  = 0;
+    rng_Seed      = 0;
+    nb_Interval   = 1;
+    pc_Integration = 0;
+    master_Threads = 1;
+    bp_State       = 0;
+    task_Graph     = 0;
+    
+    merge_Displs  = NULL;
+    merge_Sources = NULL;
+    
     prm_File     = "./test/GC90c12.prm";
     crd_File     = "./test/GC90_6c.crd";
     energy_File  = "./data/energies.eng";
@@ -47,11 +74,11 @@ IO::~IO(void) {
     delete []crd.BP_Atoms;
     delete []crd.BP_Crds;
     delete []crd.BP_Vels;
+    delete []merge_Displs;
+    delete []merge_Sources;
     
-    // Deallocate memory spaces of all tetrads
-    for (int i = 0; i < prm.num_Tetrads; i++) {
-        tetrad[i].deallocate_Tetrad_Arrays();
-    }
+    // Deallocate memory spaces of all tetrads (in the contiguous buffers)
+    Tetrad::deallocate_Packed_Arrays(tetrad, prm.num_Tetrads);
     
 }
 
@@ -69,7 +96,7 @@ void IO::read_Cofig(EDMD* edmd) {
     if (fin.is_open()) {
     
         // Read config data line by line and get the desired data
-        for (int i = 1; i < 18; i++) {
+        for (int i = 1; i < 39; i++) {
             fin.getline(line, sizeof(line));
             stringstream data_Line(line);
             istringstream iss;
@@ -98,6 +125,28 @@ void IO::read_Cofig(EDMD* edmd) {
                 case 15: data_Line >> s1 >> s2 >> energy_File;  break;
                 case 16: data_Line >> s1 >> s2 >> trj_File;     break;
                 case 17: data_Line >> s1 >> s2 >> new_Crd_File; break;
+                    
+                case 18: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> nb_Schedule; break;
+                case 19: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> nb_Chunk;    break;
+                case 20: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> load_Balance; break;
+                case 21: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> lb_Damping;   break;
+                case 22: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> nb_Partition; break;
+                case 23: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> master_Share; break;
+                case 24: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> ed_Workers;   break;
+                case 25: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> nb_Reduce;    break;
+                case 26: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> nb_Overlap;   break;
+                case 27: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> integration;  break;
+                case 28: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> crd_Exchange; break;
+                case 29: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> shm_Node;     break;
+                case 30: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> omp_Threads;  break;
+                case 31: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> crd_Precision; break;
+                case 32: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> crd_Validate;  break;
+                case 33: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> rng_Seed;      break;
+                case 34: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> nb_Interval;   break;
+                case 35: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> pc_Integration; break;
+                case 36: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> master_Threads; break;
+                case 37: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> bp_State;       break;
+                case 38: data_Line >> s1 >> s2 >> s3; iss.str(s3); iss >> task_Graph;     break;
             }
         }
         
@@ -108,6 +157,135 @@ void IO::read_Cofig(EDMD* edmd) {
         exit(1);
     }
     
+    // Check the scheduling parameters
+    if (nb_Schedule < 0 || nb_Schedule > 2) {
+        cout << ">>> ERROR: Unknown NB schedule in the Config file!" << endl;
+        exit(1);
+    }
+    if (nb_Partition < 0 || nb_Partition > 1) {
+        cout << ">>> ERROR: Unknown NB partition in the Config file!" << endl;
+        exit(1);
+    }
+    if (nb_Reduce < 0 || nb_Reduce > 2) {
+        cout << ">>> ERROR: Unknown NB reduction in the Config file!" << endl;
+        exit(1);
+    }
+    if (nb_Chunk < 1) nb_Chunk = 1;
+    if (lb_Damping <= 0.0 || lb_Damping > 1.0) lb_Damping = 1.0;
+    if (master_Share < 0.0) master_Share = 0.0;
+    if (ed_Workers < -1) ed_Workers = -1;
+    if (nb_Overlap && nb_Reduce == 2) {
+        cout << ">>> WARNING: The NB reduction tree can not overlap the ED forces, nb_Overlap disabled." << endl;
+        nb_Overlap = 0;
+    }
+    
+    // The distributed integration runs the steps without master, so the options
+    // which need master during the steps are disabled
+    if (integration < 0 || integration > 1) {
+        cout << ">>> ERROR: Unknown integration in the Config file!" << endl;
+        exit(1);
+    }
+    if (integration && (nb_Schedule != 0 || nb_Reduce != 0 || nb_Overlap != 0 ||
+                        ed_Workers != 0 || master_Share > 0.0)) {
+        cout << ">>> WARNING: The distributed integration only supports the static NB schedule, "
+             << "the dense NB reduction, no ED & NB groups and no master share, others disabled." << endl;
+        nb_Schedule = nb_Reduce = nb_Overlap = ed_Workers = 0;
+        master_Share = 0.0;
+    }
+    
+    // The workers taking chunks dynamically may need the coordinates of any tetrad
+    if (crd_Exchange < 0 || crd_Exchange > 1) {
+        cout << ">>> ERROR: Unknown coordinate exchange in the Config file!" << endl;
+        exit(1);
+    }
+    if (crd_Exchange && nb_Schedule != 0) {
+        cout << ">>> WARNING: The halo exchange of coordinates requires the static NB schedule, crd_Exchange disabled." << endl;
+        crd_Exchange = 0;
+    }
+    
+    // The shared memory of nodes replaces the broadcast of coordinates & the
+    // reduction of NB forces of the master integration
+    if (shm_Node < 0 || shm_Node > 1) {
+        cout << ">>> ERROR: Unknown shared memory mode in the Config file!" << endl;
+        exit(1);
+    }
+    if (shm_Node && integration) {
+        cout << ">>> WARNING: The shared memory of nodes requires the master integration, shm_Node disabled." << endl;
+        shm_Node = 0;
+    }
+    if (shm_Node && (nb_Reduce != 0 || nb_Overlap != 0 || ed_Workers != 0 || crd_Exchange != 0)) {
+        cout << ">>> WARNING: The shared memory of nodes only supports the dense NB reduction, "
+             << "no ED & NB groups and no halo exchange, others disabled." << endl;
+        nb_Reduce = nb_Overlap = ed_Workers = crd_Exchange = 0;
+    }
+    
+    // The OpenMP threads of workers & master (0: the default of the OpenMP runtime)
+    if (omp_Threads < 0 || master_Threads < 0) {
+        cout << ">>> ERROR: Negative number of OpenMP threads in the Config file!" << endl;
+        exit(1);
+    }
+#ifndef _OPENMP
+    if (omp_Threads > 1 || master_Threads > 1) {
+        cout << ">>> WARNING: The program is built without OpenMP, omp_Threads & master_Threads ignored." << endl;
+        omp_Threads = 0;
+        master_Threads = 1;
+    }
+#endif
+    
+    // The reduced precision of the coordinates broadcast to workers
+    if (crd_Precision < 0 || crd_Precision > 2) {
+        cout << ">>> ERROR: Unknown coordinate precision in the Config file!" << endl;
+        exit(1);
+    }
+    if (crd_Precision && (integration || shm_Node || crd_Exchange)) {
+        cout << ">>> WARNING: The reduced coordinate precision only applies to the broadcast "
+             << "of coordinates of the master integration, crd_Precision disabled." << endl;
+        crd_Precision = 0;
+    }
+    if (!crd_Precision) crd_Validate = 0;
+    
+    // The seed of the random terms
+    if (rng_Seed < 0) {
+        cout << ">>> ERROR: Negative seed of the random terms in the Config file!" << endl;
+        exit(1);
+    }
+    
+    // The multiple time stepping (the NB forces are fresh at the last step of sync)
+    if (nb_Interval < 1) {
+        cout << ">>> ERROR: The NB interval in the Config file must be at least 1!" << endl;
+        exit(1);
+    }
+    if (ntsync % nb_Interval != 0) {
+        cout << ">>> WARNING: ntsync is not a multiple of nb_Interval, nb_Interval set to 1." << endl;
+        nb_Interval = 1;
+    }
+    
+    // The integration in the PC subspace (on master, the PC states are broadcast
+    // to all workers with the header)
+    if (pc_Integration && (integration || crd_Exchange || shm_Node || ed_Workers != 0 || crd_Precision)) {
+        cout << ">>> WARNING: The PC integration requires the master integration & the "
+             << "broadcast of full-precision coordinates to all workers, pc_Integration disabled." << endl;
+        pc_Integration = 0;
+    }
+    
+    // The single copy of the base pairs (integrated on master)
+    if (bp_State && (integration || pc_Integration || shm_Node || crd_Precision)) {
+        cout << ">>> WARNING: The single copy of the base pairs requires the master integration "
+             << "of the Cartesian coordinates & the coordinates sent from the views of tetrads, "
+             << "bp_State disabled." << endl;
+        bp_State = 0;
+    }
+    
+    // The graph of tasks is a step of the standalone engine (master needs the NB
+    // forces of all tetrads from the reduction before it integrates any of them)
+#ifndef STANDALONE
+    if (task_Graph) {
+        cout << ">>> WARNING: The graph of tasks is only run by the standalone engine, "
+             << "task_Graph disabled." << endl;
+        task_Graph = 0;
+    }
+#endif
+    
     // Remove old file before new simualtion starts
     file = energy_File.c_str();  remove(file);
     file = trj_File.c_str();     remove(file);
@@ -173,6 +351,9 @@ void IO::read_Prm(void) {
         
         fin.close();
         
+        // Move the arrays of tetrads into contiguous buffers for message passing
+        Tetrad::pack_Tetrad_Arrays(tetrad, prm.num_Tetrads);
+        
     } else {
         cout << ">>> ERROR: Can not open the prm file!" << endl;
         exit(1);
@@ -266,10 +447,19 @@ void IO::initialise_Tetrad_Crds(void) {
         // Check if all data is matching, otherwise quit simulation
         if (num_Atoms != tetrad[i].num_Atoms) {
             cout << ">>> ERROR: The number of atoms in crd file is wrong." << endl;
-            MPI_Abort(MPI_COMM_WORLD, error_Code);
+            error_Code = 1;
         } else if ((end_Index - start_Index + 1) != (3 * num_Atoms)) {
             cout << ">>> ERROR: Index goes wrong." << endl;
+            error_Code = 1;
+        }
+        
+        // The standalone engine is a single process without MPI
+        if (error_Code) {
+#ifdef STANDALONE
+            exit(1);
+#else
             MPI_Abort(MPI_COMM_WORLD, error_Code);
+#endif
         }
         
         // Read in the initial coordinates & velocities, initialise forces to 0
@@ -289,6 +479,152 @@ void IO::initialise_Tetrad_Crds(void) {
 
 
 
+void IO::cal_Centre_of_Mass(double** com) {
+    
+    // Calculate the centre of mass (actually, centre of geom)
+    for (int i = 0; i < prm.num_Tetrads; i++) {
+        
+        com[i][0] = com[i][1] = com[i][2] = 0.0;
+        
+        for (int j = 0; j < 3 * tetrad[i].num_Atoms; j += 3) {
+            com[i][0] += tetrad[i].coordinates[ j ];
+            com[i][1] += tetrad[i].coordinates[j+1];
+            com[i][2] += tetrad[i].coordinates[j+2];
+        }
+        
+        com[i][0] /= tetrad[i].num_Atoms;
+        com[i][1] /= tetrad[i].num_Atoms;
+        com[i][2] /= tetrad[i].num_Atoms;
+        
+    }
+    
+}
+
+
+
+int IO::generate_Pair_Lists(double** pair_Lists, EDMD* edmd) {
+    
+    int i, j, num_Pairs;
+    double r, ** com = Array::allocate_2D_Double_Array(prm.num_Tetrads, 3);
+    
+    cal_Centre_of_Mass(com);
+    
+    // Loop to generate pair lists
+    for (num_Pairs = 0, i = 0; i < prm.num_Tetrads; i++) {
+        for (j = i + 1; j < prm.num_Tetrads; j++) {
+            
+            r = (com[i][0] - com[j][0]) * (com[i][0] - com[j][0]) + (com[i][1] - com[j][1]) * (com[i][1] - com[j][1]) + (com[i][2] - com[j][2]) * (com[i][2] - com[j][2]);
+            
+            // If r exceeds mole_Cutoff then no interaction between these two mols
+            if ((r < (edmd->mole_Cutoff * edmd->mole_Cutoff)) && (abs(i - j) > edmd->mole_Least) &&
+                (abs(i - j) < (prm.num_Tetrads - edmd->mole_Least))) {
+                
+                if ((abs(i - j) % 2 == 1 && (i - j) < 0) || (abs(i - j) % 2 == 0 && (i - j) > 0)) {
+                    pair_Lists[num_Pairs][0] = j; pair_Lists[num_Pairs][1] = i;
+                } else {
+                    pair_Lists[num_Pairs][0] = i; pair_Lists[num_Pairs][1] = j;
+                }
+                
+                num_Pairs++;
+            }
+        }
+    }
+    
+    Array::deallocate_2D_Double_Array(com);
+    
+    return num_Pairs;
+    
+}
+
+
+
+void IO::generate_Merge_Sources(void) {
+    
+    int i, j, num_Crds = 0;
+    
+    for (i = 0; i < prm.num_Tetrads; i++) { num_Crds += 3 * tetrad[i].num_Atoms; }
+    
+    // The sources of every coordinate of the DNA in the order of tetrads (the
+    // velocities of all tetrads have the offsets of the coordinates)
+    merge_Displs  = new int [3 * crd.total_Atoms + 1];
+    merge_Sources = new int [num_Crds];
+    for (i = 0; i <= 3 * crd.total_Atoms; i++) { merge_Displs[i] = 0; }
+    for (i = 0; i < prm.num_Tetrads; i++) {
+        for (j = 0; j < 3 * tetrad[i].num_Atoms; j++) { merge_Displs[displs[i] + j + 1]++; }
+    }
+    for (i = 0; i < 3 * crd.total_Atoms; i++) { merge_Displs[i + 1] += merge_Displs[i]; }
+    for (i = 0; i < prm.num_Tetrads; i++) {
+        int offset = tetrad[i].coordinates - tetrad[0].coordinates;
+        for (j = 0; j < 3 * tetrad[i].num_Atoms; j++) {
+            merge_Sources[merge_Displs[displs[i] + j]++] = offset + j;
+        }
+    }
+    for (i = 3 * crd.total_Atoms; i > 0; i--) { merge_Displs[i] = merge_Displs[i - 1]; }
+    merge_Displs[0] = 0;
+    
+}
+
+
+
+void IO::merge_Vels_n_Crds(double* velocities, double* coordinates, EDMD* edmd) {
+    
+    int i, j, index, count;
+    double * vels = tetrad[0].velocities, * crds = tetrad[0].coordinates; // All tetrads
+    
+    // The velocities of the tetrads integrated in the PC subspace
+    if (pc_Integration) {
+        #pragma omp parallel for schedule(dynamic)
+        for (i = 0; i < prm.num_Tetrads; i++) { edmd->reconstruct_Vels(&tetrad[i]); }
+    }
+    
+    // Gather all velocities & coordinates into a single array (every coordinate
+    // sums up its sources in the order of tetrads, from 0)
+    #pragma omp parallel for private(j) schedule(static)
+    for (i = 0; i < 3 * crd.total_Atoms; i++) {
+        velocities[i] = coordinates[i] = 0.0;
+        for (j = merge_Displs[i]; j < merge_Displs[i + 1]; j++) {
+            velocities [i] += vels[merge_Sources[j]];
+            coordinates[i] += crds[merge_Sources[j]];
+        }
+    }
+    
+    // Process the first & last 3 tetrads (in parallel unless the two ranges overlap)
+    index = displs[crd.num_BP - 3];
+    count = displs[crd.num_BP] - index;
+    #pragma omp parallel for schedule(static) if (count <= index)
+    for (i = 0; i < count; i++) {
+        velocities [index + i] += velocities [i]; velocities [i] = velocities [index + i];
+        coordinates[index + i] += coordinates[i]; coordinates[i] = coordinates[index + i];
+    }
+    
+    // Divide velocities & coordinates by 4
+    #pragma omp parallel for schedule(static)
+    for (i = 0; i < 3 * crd.total_Atoms; i++) {
+        velocities[i] *= 0.25; coordinates[i] *= 0.25;
+    }
+    
+    // Restore the velocities & coordinates back to tetrads
+    #pragma omp parallel for private(j, index) schedule(static)
+    for (i = 0; i < prm.num_Tetrads; i++) {
+        for (index = displs[i], j = 0; j < 3 * tetrad[i].num_Atoms; index++, j++) {
+            tetrad[i].velocities [j] = velocities [index];
+            tetrad[i].coordinates[j] = coordinates[index];
+        }
+    }
+    
+    // The PC states of the merged tetrads (fitted & projected again)
+    if (pc_Integration) {
+        #pragma omp parallel for schedule(dynamic)
+        for (i = 0; i < prm.num_Tetrads; i++) {
+            edmd->initialise_PC_State(&tetrad[i]);
+            edmd->reconstruct_Crds(&tetrad[i]);
+        }
+    }
+    
+}
+
+
+
 void IO::write_Energies(int istep, double energies[]) {
     
     ofstream fout;
@@ -384,3 +720,40 @@ void IO::update_Crd_File(double* velocities, double* coordinates) {
 
 
 
+void IO::write_Info(int istep, double* coordinates) {
+    
+    double energies[4] = {0.0};
+    
+    // Gather energies & temperature of tetrads together
+    for (int i = 0; i < prm.num_Tetrads; i++) {
+        energies[0] += tetrad[i].ED_Forces[3 * tetrad[i].num_Atoms];
+        energies[1] += tetrad[i].NB_Forces[3 * tetrad[i].num_Atoms];
+        energies[2] += tetrad[i].NB_Forces[3 * tetrad[i].num_Atoms + 1];
+        energies[3] += tetrad[i].temperature;
+    }
+    
+    // Calculate the average temperature of tetrads
+    energies[3] /= prm.num_Tetrads;
+    
+    // Wrtie out energies
+    write_Energies(istep + ntsync, energies);
+    
+    // Write trajectory
+    // displs[crd.num_BP - 3] is the index that the afterwards 3
+    // tetrads the same as the first three tetrads
+    write_Trajectory(istep, displs[crd.num_BP - 3], coordinates);
+    
+}
+
+
+
+int IO::is_NB_Step(int md_Step) {
+    
+    int i = md_Step % ntsync;
+    
+    return (i == 0 || (i + 1) % nb_Interval == 0);
+    
+}
+
+
+
@@ -26,7 +26,9 @@
 #include <fstream>
 #include <sstream>
 #include <cstdio>
+#ifndef STANDALONE
 #include "mpi.h"
+#endif
 
 #include "array.hpp"
 #include "edmd.hpp"
@@ -82,11 +84,69 @@ public:
     
     int * displs;   // The displacements of base pairs
     
+    int * merge_Displs;  // The first source of every coordinate of the DNA in the merge
+    
+    int * merge_Sources; // The sources (offsets in the coordinates of all tetrads, in the
+                         // order of tetrads) of the coordinates of the DNA
+    
     int irest;      // Indicates to read which crd file
     int nsteps;     // The total steps of iterations
     int ntsync;     // The frequency of synchronization
     int ntwt;       // The frequency of writing of energy & trajectory
     int ntpr;       // The frequency of updating the crd file
+    
+    int nb_Schedule; // The NB workload schedule (0: static, 1: dynamic, 2: guided)
+    int nb_Chunk;    // The (minimum) number of pairs per chunk in dynamic schedules
+    
+    int    load_Balance; // Rebalance the workload by the measured time (0: off, 1: on)
+    double lb_Damping;   // The damping factor (0, 1] of the workload shift per sync
+    
+    int nb_Partition; // The pair-to-worker assignment (0: pair list order, 1: locality)
+    
+    double master_Share; // The weight of master in the workload (0: master does no forces)
+    
+    int ed_Workers;   // The number of workers in the ED group (0: no groups, -1: auto)
+    
+    int nb_Reduce;    // The NB force reduction (0: dense, 1: touched rows, 2: tree of touched rows)
+    
+    int nb_Overlap;   // Overlap the NB force reduction with the ED forces (0: off, 1: on)
+    
+    int integration;  // The integration of tetrads (0: on master, 1: distributed on workers)
+    
+    int crd_Exchange; // The coordinates sent to a process (0: all tetrads, 1: halo of needed tetrads)
+    
+    int shm_Node;     // Share the coordinates & NB forces in the memory of nodes (0: off, 1: on)
+    
+    int omp_Threads;  // The number of OpenMP threads of workers (0: the OpenMP default)
+    
+    int crd_Precision; // The coordinates broadcast to workers (0: double, 1: float,
+                       // 2: float deltas from the full-precision frame of the last sync),
+                       // only for the NB forces (the own tetrads of the ED forces are in double)
+    
+    int crd_Validate;  // Report the NB energy deviation of the reduced precision at the steps
+                       // of the energies (0: off, 1: on)
+    
+    int rng_Seed;      // The seed of the random terms (0: a new seed from the time every run)
+    
+    int nb_Interval;   // The NB forces are calculated every nb_Interval steps and held in
+                       // between (multiple time stepping, 1: every step)
+    
+    int pc_Integration; // The integration of tetrads (0: Cartesian coordinates, 1: PC amplitudes
+                        // & rigid-body frames, the coordinates are reconstructed for the NB steps)
+    
+    int master_Threads; // The number of OpenMP threads of master (0: the OpenMP default)
+    
+    int bp_State;       // The state of the DNA integrated by master (0: four copies in the
+                        // tetrads merged at sync, 1: a single copy of the base pairs, the
+                        // coordinates of tetrads are views of it). It replaces the four
+                        // copies of the coordinates & velocities by the sums of the ED & NB
+                        // forces of the base pairs. The dynamics differ: the views are
+                        // averaged at every step instead of at sync, and the Berendsen
+                        // temperature control applies to the whole DNA, not per tetrad
+    
+    int task_Graph;     // The step as a graph of tasks of the standalone engine (0: bulk-
+                        // synchronous phases, 1: every tetrad integrates as soon as its own
+                        // ED & NB forces are complete), disabled with MPI
 
     // The strings of the input/output file paths
     string prm_File;
@@ -164,6 +224,49 @@ public:
      */
     void initialise_Tetrad_Crds(void);
     
+    /**
+     * Function:   Calculate the centre of mass of all tetrads.
+     *
+     * Parameters: double** com -> The centres of mass
+     *
+     * Returns:    None.
+     */
+    void cal_Centre_of_Mass(double** com);
+    
+    /**
+     * Function:   Generate the pair lists of tetrads with NB interactions (the centres
+     *             of mass within mole_Cutoff, the tetrads more than mole_Least apart).
+     *
+     * Parameters: double** pair_Lists -> The pair lists of tetrads
+     *             EDMD* edmd          -> The cutoffs of the pairs
+     *
+     * Returns:    The number of pairs.
+     */
+    int generate_Pair_Lists(double** pair_Lists, EDMD* edmd);
+    
+    /**
+     * Function:   Generate the sources of every coordinate of the DNA in the merge of
+     *             the overlapping tetrads ("merge_Displs" & "merge_Sources").
+     *
+     * Parameters: None.
+     *
+     * Returns:    None.
+     */
+    void generate_Merge_Sources(void);
+    
+    /**
+     * Function:   Merge the velocities & coordinates of the overlapping tetrads (the
+     *             average of the 4 copies of every base pair) and restore them back to
+     *             tetrads. The tetrads in the PC subspace are fitted & projected again.
+     *
+     * Parameters: double* velocities  -> The velocities  of the DNA
+     *             double* coordinates -> The coordinates of the DNA
+     *             EDMD* edmd          -> The PC subspace of tetrads
+     *
+     * Returns:    None.
+     */
+    void merge_Vels_n_Crds(double* velocities, double* coordinates, EDMD* edmd);
+    
     /**
      * Function:   Write out the energies & temperature of the DNA.
      *             All the energies & temperature of tetrads should be summed up before calling
@@ -198,6 +301,28 @@ public:
      */
     void update_Crd_File(double* velocities, double* coordinates);
     
+    /**
+     * Function:   Write out the energies & temperature summed up from tetrads, and
+     *             the trajectory of the DNA.
+     *
+     * Parameters: int istep           -> The iterations of the ED/MD simulation
+     *             double* coordinates -> The coordinates of the DNA
+     *
+     * Returns:    None.
+     */
+    void write_Info(int istep, double* coordinates);
+    
+    /**
+     * Function:  Whether the NB forces are calculated at a step: the first step after
+     *            sync & the last step of every nb_Interval steps (they are held in
+     *            between, multiple time stepping)
+     *
+     * Parameter: int md_Step -> The step of the simulation
+     *
+     * Return:    1 at the NB steps, otherwise 0
+     */
+    int is_NB_Step(int md_Step);
+    
 };
 
 #endif /* io_hpp */
@@ -28,12 +28,17 @@ using namespace std;
 
 int main(int argc, char *argv[]){
     
-    int rank, size;
+    int rank, size, provided;
     
-    MPI_Init(&argc, &argv);
+    // The OpenMP threads of workers do not call MPI (only the master thread)
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
     
+    if (provided < MPI_THREAD_FUNNELED && rank == 0) {
+        cout << ">>> WARNING: The MPI library does not support MPI_THREAD_FUNNELED." << endl;
+    }
+    
     // The ED/MD simulation requires at least 2 processes
     if (size < 2) {
         cout << "The program requires at least 2 processes." << endl;
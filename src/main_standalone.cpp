@@ -0,0 +1,77 @@
+/********************************************************************************
+ *                                                                              *
+ *          Porting the Essential Dynamics/Molecular Dynamics method            *
+ *             for large-scale nucleic acid simulations to ARCHER               *
+ *                                                                              *
+ *                               Zhuowei Si                                     *
+ *              EPCC supervisors: Elena Breitmoser, Iain Bethune                *
+ *     External supervisor: Charlie Laughton (The University of Nottingham)     *
+ *                                                                              *
+ *                  MSc in High Performance Computing, EPCC                     *
+ *                       The University of Edinburgh                            *
+ *                                                                              *
+ *******************************************************************************/
+
+/**
+ * File:  main_standalone.cpp
+ * Brief: The entry of the standalone engine. A single process (threaded with
+ *        OpenMP) runs the whole simulation, without MPI.
+ */
+
+#include <iostream>
+#include <ctime>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "standalone.hpp"
+
+using namespace std;
+
+int main(void){
+    
+    Standalone engine;
+    
+    // The wall time (the CPU time of clock() sums up all threads)
+#ifdef _OPENMP
+    double start_Time = omp_get_wtime();
+#else
+    clock_t start_Time = clock();
+#endif
+    
+    engine.initialise();
+    
+    for (int istep = 0; istep < engine.io.nsteps; istep += engine.io.ntsync) {
+    
+        cout << "istep: " << istep << endl;
+    
+        engine.generate_Pair_Lists();
+    
+        for (int i = 0; i < engine.io.ntsync; i++) {
+    
+            if (engine.io.task_Graph) {
+                engine.step_Task_Graph();
+            } else {
+                engine.calculate_Forces();
+                engine.update_Velocity();
+                engine.update_Coordinate();
+            }
+    
+        }
+    
+        engine.merge_Vels_n_Crds();
+    
+        if (istep % engine.io.ntwt == 0) { engine.write_Info(istep); }
+        if (istep % engine.io.ntpr == 0) { engine.write_Crds(); }
+    
+    }
+    
+#ifdef _OPENMP
+    double time_Usage = omp_get_wtime() - start_Time;
+#else
+    double time_Usage = double (clock() - start_Time) / CLOCKS_PER_SEC;
+#endif
+    cout << "Simulation ended.\nTime usage of simualtion: " << time_Usage << endl << endl;
+    
+    return 0;
+}
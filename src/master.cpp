@@ -22,11 +22,25 @@
 
 Master::Master(void) {
     
-    num_Pairs = 0;
-    max_Atoms = 0;
+    num_Pairs  = 0;
+    max_Atoms  = 0;
+    num_Chunks = 0;
+    NB_Counter = 0;
+    timed_Steps = 0;
+    md_Step     = 0;
+    full_Frame  = 1;
+    nb_Step     = 1;
+    energy_Step = 1;
+    crd_Deviation = 0.0;
     
     comm      = MPI_COMM_WORLD;
     MPI_Comm_size(comm, &size); // Get size of MPI processes
+    
+    // Without the ED & NB groups, the NB group is all processes
+    ed_Group  = 0;
+    split_Group = -1;
+    ED_Comm   = MPI_COMM_NULL;
+    NB_Comm   = comm;
 
 }
 
@@ -38,15 +52,74 @@ Master::~Master(void) {
     array.deallocate_2D_Double_Array(pair_Lists);
     array.deallocate_2D_Int_Array(ED_Index);
     array.deallocate_2D_Int_Array(NB_Index);
-    array.deallocate_2D_Double_Array(NB_Forces);
+    array.deallocate_2D_Int_Array(NB_Chunks);
+    if (!io.shm_Node) array.deallocate_2D_Double_Array(NB_Forces);
+    delete [] ED_Time;
+    delete [] NB_Time;
+    delete [] NB_Rows;
+    delete [] touched;
+    delete [] ED_Weight;
+    delete [] NB_Weight;
     delete [] velocities;
     delete [] coordinates;
+    if (io.bp_State) {
+        delete [] bp_ED;
+        delete [] bp_NB;
+        delete [] bp_KE;
+        
+        // The views are not in the buffers of tetrads
+        for (int i = 0; i < io.prm.num_Tetrads; i++) { io.tetrad[i].coordinates = NULL; }
+    }
+    if (io.crd_Precision) {
+        delete [] crd_Floats;
+        delete [] crd_Ref;
+        delete [] crd_Sent;
+    }
+    if (io.master_Share > 0.0 && !io.bp_State) delete [] share_Copy;
     
     // Free the MPI_Datatype
     for (int i = 0; i < io.prm.num_Tetrads; i++) {
         mpi.free_MPI_ED_Forces(&(MPI_ED_Forces[i]));
     }
     mpi.free_MPI_Crds(&MPI_Crds);
+    if (header_Crds) mpi.free_MPI_Crds(&MPI_Header);
+    if (io.pc_Integration) mpi.free_MPI_Crds(&MPI_PC_Crds);
+    
+    // Free the RMA window of the NB chunk counter
+    if (io.nb_Schedule != 0) MPI_Win_free(&NB_Win);
+    
+    // Free the communicators & MPI_Datatype of the ED & NB groups
+    for (int i = 0; i < size; i++) {
+        if (MPI_ED_Crds[i] != MPI_DATATYPE_NULL) mpi.free_MPI_Crds(&(MPI_ED_Crds[i]));
+        if (MPI_Halo[i]    != MPI_DATATYPE_NULL) mpi.free_MPI_Crds(&(MPI_Halo[i]));
+    }
+    delete [] MPI_ED_Crds;
+    delete [] MPI_Halo;
+    if (ED_Comm != MPI_COMM_NULL) MPI_Comm_free(&ED_Comm);
+    if (NB_Comm != comm) MPI_Comm_free(&NB_Comm);
+    
+    // Free the shared memory & the communicators of nodes (the NB force array
+    // is in the shared memory)
+    if (io.shm_Node) {
+        MPI_Win_unlock_all(crd_Win);
+        MPI_Win_unlock_all(force_Win);
+        MPI_Win_free(&crd_Win);
+        MPI_Win_free(&force_Win);
+        MPI_Comm_free(&node_Comm);
+        MPI_Comm_free(&leader_Comm);
+        delete [] NB_Forces;
+        delete [] node_Forces;
+        delete [] crd_Displs;
+    }
+    
+    // Free the MPI_Datatype of the distributed integration
+    if (io.integration) {
+        for (int i = 0; i < io.prm.num_Tetrads; i++) {
+            mpi.free_MPI_State(&(MPI_State[i]));
+        }
+        delete [] MPI_State;
+        mpi.free_MPI_State(&MPI_Vels_n_Crds);
+    }
     
 }
 
@@ -61,26 +134,142 @@ void Master::initialise(void) {
     io.read_Crd();
     io.initialise_Tetrad_Crds();
     
+    // The OpenMP threads of master (the loops over tetrads)
+#ifdef _OPENMP
+    if (io.master_Threads > 0) omp_set_num_threads(io.master_Threads);
+#endif
+    
     // Inintialise the output frequencies
     io.ntwt -= io.ntwt % io.ntsync; if (io.ntwt == 0) io.ntwt = 1;
     io.ntpr -= io.ntpr % io.ntsync; if (io.ntpr == 0) io.ntpr = 1;
     
-    // Create MPI_Datatype for message passing
+    // The seed of the random terms (a new one every run unless set in the Config file)
+    edmd.rng.seed = io.rng_Seed > 0 ? (unsigned int) io.rng_Seed : (unsigned int) time(NULL);
+    
+    // The integration constants of tetrads
+    edmd.initialise_Constants(io.tetrad, io.prm.num_Tetrads);
+    
+    // The states of tetrads in the PC subspace (the coordinates in the subspace)
+    if (io.pc_Integration) {
+        for (int i = 0; i < io.prm.num_Tetrads; i++) {
+            edmd.initialise_PC_State(&io.tetrad[i]);
+            edmd.reconstruct_Crds(&io.tetrad[i]);
+        }
+    }
+    
+    // The velocities & coordinates of the DNA (the last 3 base pairs are the first 3)
+    velocities  = new double [3 * io.crd.total_Atoms];
+    coordinates = new double [3 * io.crd.total_Atoms];
+    num_BP_Crds = io.displs[io.crd.num_BP - 3];
+    
+    // The single copy of the base pairs: tetrad i is base pairs i to i+3, so its
+    // coordinates are a view of the coordinates of the DNA (the last 3 tetrads
+    // reach the last 3 base pairs, kept as a copy of the first 3). The buffers of
+    // the coordinates & velocities of tetrads are freed.
+    if (io.bp_State) {
+        bp_ED = new double [num_BP_Crds];
+        bp_NB = new double [num_BP_Crds];
+        bp_KE = new double [io.crd.num_BP];
+        
+        for (int i = 0; i < io.prm.num_Tetrads; i++) {
+            for (int j = 0; j < 3 * io.crd.BP_Atoms[i]; j++) {
+                velocities [io.displs[i] + j] = io.tetrad[i].velocities[j];
+                coordinates[io.displs[i] + j] = io.tetrad[i].coordinates[j];
+            }
+        }
+        for (int g = 0; g < num_BP_Crds; g++) { bp_NB[g] = 0.0; }
+        copy_BP_Tail();
+        
+        free(io.tetrad[0].velocities);
+        free(io.tetrad[0].coordinates);
+        for (int i = 0; i < io.prm.num_Tetrads; i++) {
+            io.tetrad[i].velocities  = NULL;
+            io.tetrad[i].coordinates = coordinates + io.displs[i];
+        }
+    }
+    
+    // Create MPI_Datatype for message passing. The views of the single copy
+    // receive their shaken coordinates in place of the random terms (not used by
+    // the single copy), the views themselves are only read during the step.
     MPI_ED_Forces = new MPI_Datatype [io.prm.num_Tetrads]; // For every tetrad
     for (int i = 0; i < io.prm.num_Tetrads; i++) {
-        if(max_Atoms < io.tetrad[i].num_Atoms) max_Atoms = io.tetrad[i].num_Atoms;
-        mpi.create_MPI_ED_Forces(&(MPI_ED_Forces[i]), &(io.tetrad[i]));
+        Tetrad * t = &(io.tetrad[i]);
+        double * view = t->coordinates;
+        if(max_Atoms < t->num_Atoms) max_Atoms = t->num_Atoms;
+        if (io.bp_State) t->coordinates = t->random_Terms;
+        mpi.create_MPI_ED_Forces(&(MPI_ED_Forces[i]), t);
+        t->coordinates = view;
     }
     mpi.create_MPI_Crds(&MPI_Crds, io.prm.num_Tetrads, io.tetrad);// For all tetrads
     
+    // The buffers of the coordinates broadcast in reduced precision
+    num_Crds = 0;
+    for (int i = 0; i < io.prm.num_Tetrads; i++) { num_Crds += 3 * io.tetrad[i].num_Atoms; }
+    if (io.crd_Precision) {
+        crd_Floats = new float  [num_Crds];
+        crd_Ref    = new double [num_Crds];
+        crd_Sent   = new double [num_Crds];
+    }
+    
+    // The copy of the coordinates for the NB share of master (the views of the
+    // single copy are not overwritten by the receives of the ED forces)
+    if (io.master_Share > 0.0 && !io.bp_State) share_Copy = new double [num_Crds];
+    
+    // For the states of tetrads integrated by workers
+    if (io.integration) {
+        MPI_State = new MPI_Datatype [io.prm.num_Tetrads];
+        for (int i = 0; i < io.prm.num_Tetrads; i++) {
+            mpi.create_MPI_State(&(MPI_State[i]), &(io.tetrad[i]));
+        }
+        mpi.create_MPI_Vels_n_Crds(&MPI_Vels_n_Crds, io.prm.num_Tetrads, io.tetrad);
+    }
+    
+    // The header of commands carries the coordinates (or the velocities &
+    // coordinates, or the PC amplitudes & frames) when they are broadcast to all workers
+    header_Crds = io.integration || (!io.shm_Node && !io.crd_Exchange && io.ed_Workers == 0 && !io.crd_Precision);
+    if (io.pc_Integration) {
+        mpi.create_MPI_PC_Crds(&MPI_PC_Crds, io.prm.num_Tetrads, io.tetrad);
+        mpi.create_MPI_Header(&MPI_Header, header, MPI_PC_Crds, io.tetrad);
+    } else if (header_Crds) {
+        mpi.create_MPI_Header(&MPI_Header, header, io.integration ? MPI_Vels_n_Crds : MPI_Crds, io.tetrad);
+    }
+    
     // Allocate memory for arrays
     num_Pairs  = io.prm.num_Tetrads * (io.prm.num_Tetrads - 1) / 2;
     pair_Lists = array.allocate_2D_Double_Array(num_Pairs, 2);
-    ED_Index = array.allocate_2D_Int_Array(size - 1, 2);
-    NB_Index = array.allocate_2D_Int_Array(size - 1, 2);
-    NB_Forces  = array.allocate_2D_Double_Array(io.prm.num_Tetrads, 3 * max_Atoms + 2);
-    velocities  = new double [3 * io.crd.total_Atoms];
-    coordinates = new double [3 * io.crd.total_Atoms];
+    ED_Index = array.allocate_2D_Int_Array(size, 2);
+    NB_Index = array.allocate_2D_Int_Array(size, 2);
+    NB_Chunks  = array.allocate_2D_Int_Array(num_Pairs, 2);
+    
+    // The timings of workers are piggybacked on the NB force reduction in extra rows
+    // (all rows start at 0, as master reduces in place)
+    num_Rows = io.prm.num_Tetrads;
+    if (io.load_Balance) num_Rows += (2 * size + 3 * max_Atoms + 1) / (3 * max_Atoms + 2);
+    NB_Forces  = array.allocate_2D_Double_Array(num_Rows, 3 * max_Atoms + 2);
+    for (int i = 0; i < num_Rows; i++) {
+        for (int j = 0; j < 3 * max_Atoms + 2; j++) { NB_Forces[i][j] = 0.0; }
+    }
+    NB_Rows = new double [num_Rows * (3 * max_Atoms + 3)];
+    touched = new int [num_Rows];
+    for (int i = 0; i < num_Rows; i++) { touched[i] = 0; }
+    ED_Time = new double [size];
+    NB_Time = new double [size];
+    
+    ED_Weight = new double [size];
+    NB_Weight = new double [size];
+    MPI_ED_Crds = new MPI_Datatype [size];
+    MPI_Halo    = new MPI_Datatype [size];
+    for (int i = 0; i < size; i++) { MPI_ED_Crds[i] = MPI_Halo[i] = MPI_DATATYPE_NULL; }
+    
+    // The sources of every coordinate of the DNA in the merge (the single copy of
+    // the base pairs is not merged)
+    if (!io.bp_State) io.generate_Merge_Sources();
+    
+    // The ED & NB groups need at least one worker in each group
+    if (io.ed_Workers != 0 && size < 3) {
+        cout << ">>> WARNING: The ED & NB groups require at least 3 processes, disabled." << endl;
+        io.ed_Workers = 0;
+    }
     
     // Print information of the EDMD simulation
     cout << endl << "Initialising simulation..." << endl << endl;
@@ -90,7 +279,30 @@ void Master::initialise(void) {
     cout << ">>> Total number of iterations  : " << io.nsteps << endl;
     cout << ">>> Frequency of synchronization: " << io.ntsync << endl;
     cout << ">>> Frequency of writing energy & temperature, trajectory: " << io.ntwt << endl;
-    cout << ">>> Frequency of updating th coordinates file: " << io.ntpr << endl << endl;
+    cout << ">>> Frequency of updating th coordinates file: " << io.ntpr << endl;
+    cout << ">>> NB schedule (0: static, 1: dynamic, 2: guided): " << io.nb_Schedule << endl;
+    if (io.nb_Schedule != 0) cout << ">>> NB chunk size: " << io.nb_Chunk << endl;
+    if (io.nb_Partition) cout << ">>> Locality-aware NB partition" << endl;
+    if (io.nb_Reduce == 1) cout << ">>> NB reduction of touched rows to master" << endl;
+    if (io.nb_Reduce == 2) cout << ">>> NB reduction of touched rows by a binomial tree" << endl;
+    if (io.nb_Overlap) cout << ">>> NB reduction overlapped with the ED forces" << endl;
+    if (io.integration) cout << ">>> Distributed integration of tetrads on workers" << endl;
+    if (io.crd_Exchange) cout << ">>> Halo exchange of coordinates" << endl;
+    if (io.shm_Node) cout << ">>> Coordinates & NB forces in the shared memory of nodes" << endl;
+    if (io.omp_Threads > 0) cout << ">>> OpenMP threads of workers: " << io.omp_Threads << endl;
+    if (io.bp_State) cout << ">>> Single copy of the base pairs integrated on master" << endl;
+    if (io.master_Threads != 1) cout << ">>> OpenMP threads of master (0: default): " << io.master_Threads << endl;
+    if (io.pc_Integration) cout << ">>> Integration of tetrads in the PC subspace" << endl;
+    if (io.nb_Interval > 1) cout << ">>> Multiple time stepping, NB forces every " << io.nb_Interval << " steps" << endl;
+    if (io.crd_Precision == 1) cout << ">>> Coordinates broadcast in float" << endl;
+    if (io.crd_Precision == 2) cout << ">>> Coordinates broadcast in float deltas from the last sync" << endl;
+    if (io.crd_Validate) cout << ">>> Validation of the NB energy deviation of the coordinate precision" << endl;
+    cout << ">>> Seed of the random terms: " << edmd.rng.seed << endl;
+    if (io.master_Share > 0.0) cout << ">>> Master takes a share of force calculation, weight: " << io.master_Share << endl;
+    if (io.ed_Workers > 0)   cout << ">>> Workers in the ED group: " << io.ed_Workers << endl;
+    if (io.ed_Workers == -1) cout << ">>> Workers in the ED group: auto" << endl;
+    if (io.load_Balance) cout << ">>> Load balancing by measured time, damping: " << io.lb_Damping << endl;
+    cout << endl;
     
     cout << "DNA Information:" << endl;
     cout << ">>> The number of DNA Base Pairs  : " << io.crd.num_BP      << endl;
@@ -113,9 +325,14 @@ void Master::initialise(void) {
 void Master::send_Parameters(void) {
     
     int i, * tetrad_Para = new int[2 * io.prm.num_Tetrads];
-    double edmd_Para[11] = { edmd.dt, edmd.gamma, edmd.tautp, edmd.temperature,
+    double edmd_Para[NUM_PARA] = { edmd.dt, edmd.gamma, edmd.tautp, edmd.temperature,
         edmd.scaled, edmd.mole_Cutoff, edmd.atom_Cutoff, edmd.mole_Least,
-        (double)io.prm.num_Tetrads, (double)num_Pairs, (double)max_Atoms };
+        (double)io.prm.num_Tetrads, (double)num_Pairs, (double)max_Atoms,
+        (double)io.nb_Schedule, (double)io.nb_Chunk, (double)io.load_Balance,
+        (double)io.nb_Partition, (double)io.ed_Workers, (double)io.nb_Reduce,
+        (double)io.nb_Overlap, (double)io.integration, (double)io.crd_Exchange,
+        (double)io.shm_Node, (double)io.omp_Threads, (double)io.crd_Precision,
+        (double)edmd.rng.seed, (double)io.nb_Interval, (double)io.pc_Integration };
     
     // Assign the number of atoms & evecs of tetrads into the sending array
     for (i = 0; i < io.prm.num_Tetrads; i++) {
@@ -125,9 +342,24 @@ void Master::send_Parameters(void) {
     
     // Broadcast the simulation and tetrad parameters
     cout << "Master sending parameters to workers..." << endl;
-    MPI_Bcast(edmd_Para, 11, MPI_DOUBLE, 0, comm);
+    MPI_Bcast(edmd_Para, NUM_PARA, MPI_DOUBLE, 0, comm);
     MPI_Bcast(tetrad_Para, 2 * io.prm.num_Tetrads, MPI_INT, 0, comm);
     
+    // Expose the NB chunk counter to workers for the dynamic NB schedules
+    if (io.nb_Schedule != 0) {
+        MPI_Win_create(&NB_Counter, sizeof(int), sizeof(int), MPI_INFO_NULL, comm, &NB_Win);
+    }
+    
+    // The workers integrating the tetrads have their own communicator (master
+    // is not in it)
+    if (io.integration) {
+        MPI_Comm MD_Comm;
+        MPI_Comm_split(comm, MPI_UNDEFINED, 0, &MD_Comm);
+    }
+    
+    // The shared memory of nodes
+    if (io.shm_Node) setup_Shared();
+    
     delete [] tetrad_Para;
     
 }
@@ -154,89 +386,228 @@ void Master::send_Tetrads(void) {
 
 
 
-void Master::cal_Centre_of_Mass(double** com) {
+void Master::generate_Pair_Lists(void) {
     
-    // Calculate the centre of mass (actually, centre of geom)
-    for (int i = 0; i < io.prm.num_Tetrads; i++) {
-        
-        com[i][0] = com[i][1] = com[i][2] = 0.0;
+    num_Pairs = io.generate_Pair_Lists(pair_Lists, &edmd);
+    
+}
+
+
+
+void Master::generate_Indexes(void) {
+    
+    int i, old_Group = ed_Group, num_ED = 0, num_NB = 0;
+    double max_ED = 0.0, max_NB = 0.0, sum_ED = 0.0, sum_NB = 0.0;
+    
+    // Decide the ED & NB groups of workers (& the weights of processes)
+    tune_Groups();
+    
+    if (io.load_Balance && timed_Steps > 0 && ed_Group == old_Group) {
         
-        for (int j = 0; j < 3 * io.tetrad[i].num_Atoms; j += 3) {
-            com[i][0] += io.tetrad[i].coordinates[ j ];
-            com[i][1] += io.tetrad[i].coordinates[j+1];
-            com[i][2] += io.tetrad[i].coordinates[j+2];
+        // Report the load imbalance (max / mean time) of the last synchronization
+        for (i = 0; i < size; i++) {
+            if (ED_Weight[i] > 0.0) { max_ED = max(max_ED, ED_Time[i]); sum_ED += ED_Time[i]; num_ED++; }
+            if (NB_Weight[i] > 0.0) { max_NB = max(max_NB, NB_Time[i]); sum_NB += NB_Time[i]; num_NB++; }
         }
+        cout << ">>> Load imbalance, ED: " << max_ED * num_ED / max(sum_ED, 1e-12)
+             << ", NB: " << max_NB * num_NB / max(sum_NB, 1e-12) << endl;
         
-        com[i][0] /= io.tetrad[i].num_Atoms;
-        com[i][1] /= io.tetrad[i].num_Atoms;
-        com[i][2] /= io.tetrad[i].num_Atoms;
+        // Shift the workload of processes towards equal measured time
+        balance_Workload(ED_Index, io.pc_Integration ? 0 : io.prm.num_Tetrads, ED_Time, ED_Weight);
+        balance_Workload(NB_Index, num_Pairs, NB_Time, NB_Weight);
         
+    } else {
+        
+        // Divide NB force calculation into simuilar chunk (balanced workload)
+        // For every part of the NB force caulation, it has the start point &
+        // how many NB forces to be calculated. The master (rank 0) only gets
+        // a share if master_Share is not 0 (nobody has ED forces with the
+        // integration in the PC subspace).
+        divide_Workload(ED_Index, io.pc_Integration ? 0 : io.prm.num_Tetrads, ED_Weight);
+        divide_Workload(NB_Index, num_Pairs, NB_Weight);
+        
+    }
+    
+    // Set the start index of the workload
+    ED_Index[0][0] = NB_Index[0][0] = 0;
+    for (i = 1; i < size; i++) {
+        ED_Index[i][0] = ED_Index[i - 1][0] + ED_Index[i - 1][1];
+        NB_Index[i][0] = NB_Index[i - 1][0] + NB_Index[i - 1][1];
+    }
+    
+    // Assign spatially close pairs to every process
+    if (io.nb_Partition == 1) partition_Pairs();
+    
+    // Clear the timings for the next synchronization
+    for (timed_Steps = 0, i = 0; i < size; i++) { ED_Time[i] = NB_Time[i] = 0.0; }
+    
+    // The dynamic NB schedules hand out chunks of the pair lists instead
+    if (io.nb_Schedule != 0) generate_Chunks();
+    
+}
+
+
+
+void Master::divide_Workload(int** index, int total, double* share) {
+    
+    int i, sum;
+    double share_Sum;
+    
+    for (share_Sum = 0.0, i = 0; i < size; i++) { share_Sum += share[i]; }
+    
+    for (sum = 0, i = 0; i < size; i++) {
+        index[i][1] = (int) (share[i] / share_Sum * total + 1e-9);
+        sum += index[i][1];
+    }
+    
+    // If can not be divided exactly, then the remaining works are assigned
+    // to parts of the processes.
+    for (i = 0; sum < total; i = (i + 1) % size) {
+        if (share[i] > 0.0) { index[i][1] += 1; sum++; }
     }
     
 }
 
 
 
-void Master::generate_Pair_Lists(void) {
+void Master::balance_Workload(int** index, int total, double* time, double* weight) {
+    
+    int i, old_Total, num_Rates;
+    double rate_Sum, * rate = new double [size], * share = new double [size];
+    
+    // The measured rates of processes. Processes without any workload (or time)
+    // take the average rate of the others
+    for (old_Total = 0, num_Rates = 0, rate_Sum = 0.0, i = 0; i < size; i++) {
+        old_Total += index[i][1];
+        rate[i] = 0.0;
+        if (index[i][1] > 0 && time[i] > 0.0 && weight[i] > 0.0) {
+            rate[i] = index[i][1] / time[i]; rate_Sum += rate[i]; num_Rates++;
+        }
+    }
+    for (i = 0; i < size; i++) {
+        if (rate[i] == 0.0) rate[i] = (num_Rates > 0) ? rate_Sum / num_Rates : 1.0;
+        rate[i] *= weight[i];
+    }
+    for (rate_Sum = 0.0, i = 0; i < size; i++) { rate_Sum += rate[i]; }
     
-    int i, j;
-    double r, ** com = array.allocate_2D_Double_Array(io.prm.num_Tetrads, 3);
-    
-    cal_Centre_of_Mass(com);
-    
-    // Loop to generate pair lists
-    for (num_Pairs = 0, i = 0; i < io.prm.num_Tetrads; i++) {
-        for (j = i + 1; j < io.prm.num_Tetrads; j++) {
-            
-            r = (com[i][0] - com[j][0]) * (com[i][0] - com[j][0]) + (com[i][1] - com[j][1]) * (com[i][1] - com[j][1]) + (com[i][2] - com[j][2]) * (com[i][2] - com[j][2]);
-            
-            // If r exceeds mole_Cutoff then no interaction between these two mols
-            if ((r < (edmd.mole_Cutoff * edmd.mole_Cutoff)) && (abs(i - j) > edmd.mole_Least) &&
-                (abs(i - j) < (io.prm.num_Tetrads - edmd.mole_Least))) {
-                
-                if ((abs(i - j) % 2 == 1 && (i - j) < 0) || (abs(i - j) % 2 == 0 && (i - j) > 0)) {
-                    pair_Lists[num_Pairs][0] = j; pair_Lists[num_Pairs][1] = i;
-                } else {
-                    pair_Lists[num_Pairs][0] = i; pair_Lists[num_Pairs][1] = j;
-                }
-            
-                num_Pairs++;
+    // Move the share of every process from the old one towards its target one
+    for (i = 0; i < size; i++) {
+        share[i] = (old_Total > 0) ? (double) index[i][1] / old_Total : rate[i] / rate_Sum;
+        share[i] += io.lb_Damping * (rate[i] / rate_Sum - share[i]);
+    }
+    
+    divide_Workload(index, total, share);
+    
+    delete [] rate;
+    delete [] share;
+    
+}
+
+
+
+void Master::partition_Pairs(void) {
+    
+    int i, j, k, rows, max_Rows, sum_Rows, * order = new int [num_Pairs];
+    int first = (io.master_Share > 0.0) ? 0 : 1;
+    int * owner = new int [io.prm.num_Tetrads];
+    double ** com = array.allocate_2D_Double_Array(io.prm.num_Tetrads, 3);
+    double ** mid = array.allocate_2D_Double_Array(max(num_Pairs, 1), 3);
+    double ** sorted = array.allocate_2D_Double_Array(max(num_Pairs, 1), 2);
+    
+    io.cal_Centre_of_Mass(com);
+    
+    // The midpoints of the pairs
+    for (i = 0; i < num_Pairs; i++) {
+        for (k = 0; k < 3; k++) {
+            mid[i][k] = 0.5 * (com[(int) pair_Lists[i][0]][k] + com[(int) pair_Lists[i][1]][k]);
+        }
+        order[i] = i;
+    }
+    
+    bisect_Pairs(order, 0, 0, size, mid);
+    
+    // Reorder the pair lists
+    for (i = 0; i < num_Pairs; i++) {
+        sorted[i][0] = pair_Lists[order[i]][0]; sorted[i][1] = pair_Lists[order[i]][1];
+    }
+    for (i = 0; i < num_Pairs; i++) {
+        pair_Lists[i][0] = sorted[i][0]; pair_Lists[i][1] = sorted[i][1];
+    }
+    
+    // Report the number of rows (touched tetrads) every process contributes to the reduction
+    for (i = 0; i < io.prm.num_Tetrads; i++) { owner[i] = -1; }
+    for (max_Rows = 0, sum_Rows = 0, i = first; i < size; i++) {
+        for (rows = 0, j = NB_Index[i][0]; j < NB_Index[i][0] + NB_Index[i][1]; j++) {
+            for (k = 0; k < 2; k++) {
+                if (owner[(int) pair_Lists[j][k]] != i) { owner[(int) pair_Lists[j][k]] = i; rows++; }
             }
         }
+        max_Rows = max(max_Rows, rows); sum_Rows += rows;
     }
+    cout << ">>> NB rows per process, average: " << (double) sum_Rows / (size - first)
+         << ", max: " << max_Rows << " (of " << io.prm.num_Tetrads << ")" << endl;
     
     array.deallocate_2D_Double_Array(com);
+    array.deallocate_2D_Double_Array(mid);
+    array.deallocate_2D_Double_Array(sorted);
+    delete [] order;
+    delete [] owner;
     
 }
 
 
 
-void Master::generate_Indexes(void) {
+void Master::bisect_Pairs(int* order, int first, int w0, int w1, double** mid) {
     
-    int i, loop;
+    int i, k, axis, total, left, wm = (w0 + w1) / 2;
+    double low[3], high[3];
     
-    // Divide NB force calculation into simuilar chunk (balanced workload)
-    // For every part of the NB force caulation, it has the start point &
-    // how many NB forces to be calculated
+    if (w1 - w0 < 2) return;
     
-    // Distribute the workload to workers in balance
-    for (i = 0; i < size - 1; i++) {
-        ED_Index[i][1] = io.prm.num_Tetrads / (size - 1);
-        NB_Index[i][1] = num_Pairs / (size - 1);
+    // The number of pairs of all workers & the workers of the left half
+    for (total = 0, i = w0; i < w1; i++) { total += NB_Index[i][1]; }
+    for (left  = 0, i = w0; i < wm; i++) { left  += NB_Index[i][1]; }
+    
+    // Find the longest axis of the bounding box of the midpoints
+    for (k = 0; k < 3; k++) { low[k] = 1e30; high[k] = -1e30; }
+    for (i = first; i < first + total; i++) {
+        for (k = 0; k < 3; k++) {
+            low[k]  = min(low[k],  mid[order[i]][k]);
+            high[k] = max(high[k], mid[order[i]][k]);
+        }
+    }
+    for (axis = 0, k = 1; k < 3; k++) {
+        if (high[k] - low[k] > high[axis] - low[axis]) axis = k;
     }
     
-    // If can not be divided exactly, then the remaining works are assigned
-    // to parts of the workers.
-    loop = io.prm.num_Tetrads - (ED_Index[0][1] * (size - 1));
-    for (i = 0; i < loop; i++) { ED_Index[i][1] += 1; }
-    loop = num_Pairs - (NB_Index[0][1] * (size - 1));
-    for (i = 0; i < loop; i++) { NB_Index[i][1] += 1; }
+    // Split the pairs along the axis, the first "left" pairs go to the left half
+    nth_element(order + first, order + first + left, order + first + total,
+                [mid, axis](int a, int b) { return mid[a][axis] < mid[b][axis]; });
     
-    // Set the start index of the workload
-    ED_Index[0][0] = NB_Index[0][0] = 0;
-    for (i = 1; i < size - 1; i++) {
-        ED_Index[i][0] = ED_Index[i - 1][0] + ED_Index[i - 1][1];
-        NB_Index[i][0] = NB_Index[i - 1][0] + NB_Index[i - 1][1];
+    bisect_Pairs(order, first, w0, wm, mid);
+    bisect_Pairs(order, first + left, wm, w1, mid);
+    
+}
+
+
+
+void Master::generate_Chunks(void) {
+    
+    int start, chunk, procs = 0;
+    
+    // The number of processes taking chunks
+    for (int i = 0; i < size; i++) { if (NB_Weight[i] > 0.0) procs++; }
+    
+    // The guided schedule takes half of the remaining pairs per process, which
+    // shrinks the chunks (and the idle time) towards the end of the pair lists
+    for (num_Chunks = 0, start = 0; start < num_Pairs; start += chunk, num_Chunks++) {
+        
+        chunk = io.nb_Chunk;
+        if (io.nb_Schedule == 2) chunk = max(chunk, (num_Pairs - start) / (2 * procs));
+        if (chunk > num_Pairs - start) chunk = num_Pairs - start;
+        
+        NB_Chunks[num_Chunks][0] = start;
+        NB_Chunks[num_Chunks][1] = chunk;
     }
     
 }
@@ -247,15 +618,41 @@ void Master::send_Workload_Indexes(void) {
     MPI_Request send_Request[3][size - 1];
     MPI_Status send_Status[3][size - 1];
     
-    // Send the pair lists & the workload displacements to workers
+    // Send the pair lists & the workload displacements to workers (the argument is
+    // the number of force commands of the sync, their headers carry the coordinates)
+    send_Header(TAG_PAIRS, io.integration ? 1 : io.ntsync);
+    full_Frame = 1;
     for (int i = 0; i < size - 1; i++) {
         MPI_Isend(&(pair_Lists[0][0]), 2 * num_Pairs, MPI_DOUBLE, i + 1,
                   TAG_PAIRS,     comm, &(send_Request[0][i]));
-        MPI_Isend(&(NB_Index[0][0]), 2 * (size - 1),  MPI_INT,    i + 1,
+        MPI_Isend(&(NB_Index[0][0]), 2 * size,        MPI_INT,    i + 1,
                   TAG_PAIRS + 1, comm, &(send_Request[1][i]));
-        MPI_Isend(&(ED_Index[0][0]), 2 * (size - 1),  MPI_INT,    i + 1,
+        MPI_Isend(&(ED_Index[0][0]), 2 * size,        MPI_INT,    i + 1,
                   TAG_PAIRS + 2, comm, &(send_Request[2][i]));
     }
+    
+    // Split the workers into the ED & NB groups
+    if (io.ed_Workers != 0) setup_Groups();
+    
+    // The coordinates of the own tetrads of the ED workers (of all workers with the
+    // reduced precision, the ED forces shake them & send them back to master, so
+    // they are sent in double)
+    for (int i = 1; i < size; i++) {
+        if (MPI_ED_Crds[i] != MPI_DATATYPE_NULL) mpi.free_MPI_Crds(&(MPI_ED_Crds[i]));
+        if ((i <= ed_Group || io.crd_Precision) && ED_Index[i][1] > 0) {
+            mpi.create_MPI_Crds(&(MPI_ED_Crds[i]), ED_Index[i][1], &(io.tetrad[ED_Index[i][0]]));
+        }
+    }
+    
+    // The halo of every worker for the coordinates sent by master
+    if (io.crd_Exchange && !io.integration) setup_Halo();
+    
+    // Broadcast the chunks of the pair lists for the dynamic NB schedules
+    if (io.nb_Schedule != 0) {
+        MPI_Bcast(&num_Chunks, 1, MPI_INT, 0, comm);
+        MPI_Bcast(&(NB_Chunks[0][0]), 2 * num_Chunks, MPI_INT, 0, comm);
+    }
+    
     MPI_Waitall(size - 1, send_Request[0], send_Status[0]);
     MPI_Waitall(size - 1, send_Request[1], send_Status[1]);
     MPI_Waitall(size - 1, send_Request[2], send_Status[2]);
@@ -265,148 +662,705 @@ void Master::send_Workload_Indexes(void) {
 
 
 
+void Master::send_Header(int command, int argument) {
+    
+    header[0] = command; header[1] = argument;
+    
+    // Only the force commands carry the coordinates, the others are the bare header
+    if (header_Crds && command == TAG_FORCE) {
+        MPI_Bcast(io.tetrad, 1, MPI_Header, 0, comm);
+    } else {
+        MPI_Bcast(header, 2, MPI_INT, 0, comm);
+    }
+    
+}
+
+
+
+void Master::encode_Crds(void) {
+    
+    int i;
+    double * crds = io.tetrad[0].coordinates, E_Full, E_Sent;
+    
+    // The coordinates of all tetrads are contiguous
+    for (i = 0; i < num_Crds; i++) {
+        if (io.crd_Precision == 2) {
+            crd_Floats[i] = (float) (crds[i] - crd_Ref[i]);
+            crd_Sent[i]   = crd_Ref[i] + (double) crd_Floats[i];
+        } else {
+            crd_Floats[i] = (float) crds[i];
+            crd_Sent[i]   = (double) crd_Floats[i];
+        }
+    }
+    
+    // The validation (two NB energies of all pairs) only at the steps of the energies
+    if (io.crd_Validate && energy_Step) {
+        E_Full = calculate_NB_Energy(crds);
+        E_Sent = calculate_NB_Energy(crd_Sent);
+        crd_Deviation = max(crd_Deviation, fabs(E_Sent - E_Full) / max(fabs(E_Full), 1e-12));
+    }
+    
+}
+
+
+
+double Master::calculate_NB_Energy(double* crds) {
+    
+    int i, i1, i2, width = 3 * max_Atoms + 2;
+    double energy = 0.0, * scratch = new double [2 * width];
+    Tetrad t1, t2;
+    
+    for (i = 0; i < num_Pairs; i++) {
+        i1 = pair_Lists[i][0];
+        i2 = pair_Lists[i][1];
+        
+        // Copies of the tetrads with the given coordinates
+        t1 = io.tetrad[i1]; t1.NB_Forces = scratch;
+        t2 = io.tetrad[i2]; t2.NB_Forces = scratch + width;
+        t1.coordinates = crds + (io.tetrad[i1].coordinates - io.tetrad[0].coordinates);
+        t2.coordinates = crds + (io.tetrad[i2].coordinates - io.tetrad[0].coordinates);
+        edmd.calculate_NB_Forces(&t1, &t2, 1);
+        
+        energy += 2.0 * (t1.NB_Forces[3 * t1.num_Atoms] + t1.NB_Forces[3 * t1.num_Atoms + 1]);
+    }
+    
+    delete [] scratch;
+    
+    return energy;
+    
+}
+
+
+
+void Master::tune_Groups(void) {
+    
+    int i, workers = size - 1;
+    double ED_Cost = 0.0, NB_Cost = 0.0;
+    
+    if (io.ed_Workers > 0) {
+        ed_Group = min(io.ed_Workers, workers - 1);
+    } else if (io.ed_Workers == -1) {
+        
+        if (io.load_Balance && timed_Steps > 0 && ed_Group > 0) {
+            // The measured time of the ED & NB groups
+            for (i = 1; i < size; i++) { ED_Cost += ED_Time[i]; NB_Cost += NB_Time[i]; }
+        } else {
+            // The estimated flops of the projections & forces (ED), and of the
+            // atom-atom distances (NB)
+            for (i = 0; i < io.prm.num_Tetrads; i++) {
+                ED_Cost += 18.0 * io.tetrad[i].num_Evecs * io.tetrad[i].num_Atoms;
+            }
+            for (i = 0; i < num_Pairs; i++) {
+                NB_Cost += 12.0 * io.tetrad[(int) pair_Lists[i][0]].num_Atoms * io.tetrad[(int) pair_Lists[i][1]].num_Atoms;
+            }
+        }
+        
+        // The workers of the groups in proportion to the costs
+        ed_Group = (int) (workers * ED_Cost / max(ED_Cost + NB_Cost, 1e-12) + 0.5);
+        ed_Group = max(1, min(ed_Group, workers - 1));
+    }
+    
+    // The master takes a smaller share for its integration & IO duties. Workers
+    // 1 to ed_Group are the ED group, the others are the NB group
+    ED_Weight[0] = NB_Weight[0] = io.master_Share;
+    for (i = 1; i < size; i++) {
+        ED_Weight[i] = (ed_Group == 0 || i <= ed_Group) ? 1.0 : 0.0;
+        NB_Weight[i] = (ed_Group == 0 || i >  ed_Group) ? 1.0 : 0.0;
+    }
+    
+}
+
+
+
+void Master::setup_Groups(void) {
+    
+    // Broadcast the number of workers in the ED group
+    MPI_Bcast(&ed_Group, 1, MPI_INT, 0, comm);
+    
+    // Split the workers into the ED & NB groups, master is rank 0 of both (only
+    // when the groups change, the old communicators are freed)
+    if (ed_Group != split_Group) {
+        if (ED_Comm != MPI_COMM_NULL) MPI_Comm_free(&ED_Comm);
+        if (NB_Comm != comm) MPI_Comm_free(&NB_Comm);
+        MPI_Comm_split(comm, 0, 0, &ED_Comm);
+        MPI_Comm_split(comm, 0, 0, &NB_Comm);
+        split_Group = ed_Group;
+    }
+    
+}
+
+
+
+void Master::setup_Halo(void) {
+    
+    int i, count, sum = 0, max_Count = 0;
+    int * list = new int [io.prm.num_Tetrads], * mark = new int [io.prm.num_Tetrads];
+    
+    for (i = 0; i < io.prm.num_Tetrads; i++) { mark[i] = -1; }
+    
+    for (i = 1; i < size; i++) {
+        
+        if (MPI_Halo[i] != MPI_DATATYPE_NULL) mpi.free_MPI_Crds(&(MPI_Halo[i]));
+        
+        count = mpi.list_Halo(i, ED_Index, NB_Index, pair_Lists, list, mark);
+        if (count > 0) mpi.create_MPI_Halo(&(MPI_Halo[i]), count, list, io.tetrad);
+        
+        sum += count; max_Count = max(max_Count, count);
+    }
+    
+    cout << ">>> Halo tetrads per worker, average: " << (double) sum / max(size - 1, 1)
+         << ", max: " << max_Count << " (of " << io.prm.num_Tetrads << ")" << endl;
+    
+    delete [] list;
+    delete [] mark;
+    
+}
+
+
+
+void Master::setup_Shared(void) {
+    
+    int i, j, disp_Unit, width = 3 * max_Atoms + 2;
+    MPI_Aint bytes;
+    double * base;
+    
+    // The processes of a node, and the leaders (node rank 0) of nodes. Master is
+    // the leader of its node.
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_Comm);
+    MPI_Comm_size(node_Comm, &node_Size);
+    MPI_Comm_split(comm, 0, 0, &leader_Comm);
+    
+    // The coordinates of all tetrads, one array per node (on the leader)
+    crd_Displs = new int [io.prm.num_Tetrads + 1];
+    crd_Displs[0] = 0;
+    for (i = 0; i < io.prm.num_Tetrads; i++) {
+        crd_Displs[i + 1] = crd_Displs[i] + 3 * io.tetrad[i].num_Atoms;
+    }
+    bytes = crd_Displs[io.prm.num_Tetrads] * sizeof(double);
+    MPI_Win_allocate_shared(bytes, sizeof(double), MPI_INFO_NULL, node_Comm, &shm_Crds, &crd_Win);
+    
+    // The NB force array of every process in the shared memory (the timings of
+    // workers are in the extra rows as before)
+    bytes = num_Rows * width * sizeof(double);
+    MPI_Win_allocate_shared(bytes, sizeof(double), MPI_INFO_NULL, node_Comm, &base, &force_Win);
+    array.deallocate_2D_Double_Array(NB_Forces);
+    NB_Forces = new double * [num_Rows];
+    for (i = 0; i < num_Rows; i++) {
+        NB_Forces[i] = base + i * width;
+        for (j = 0; j < width; j++) { NB_Forces[i][j] = 0.0; }
+    }
+    node_Forces = new double * [node_Size];
+    for (i = 0; i < node_Size; i++) {
+        MPI_Win_shared_query(force_Win, i, &bytes, &disp_Unit, &(node_Forces[i]));
+    }
+    
+    // The windows are accessed by load/store in a passive epoch
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, crd_Win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, force_Win);
+    
+}
+
+
+
+void Master::sync_Node(MPI_Win win) {
+    
+    MPI_Win_sync(win);
+    MPI_Barrier(node_Comm);
+    MPI_Win_sync(win);
+    
+}
+
+
+
+void Master::share_Crds(void) {
+    
+    // Write the coordinates (contiguous) into the shared memory once, and
+    // broadcast them to the leaders of the other nodes
+    memcpy(shm_Crds, io.tetrad[0].coordinates, crd_Displs[io.prm.num_Tetrads] * sizeof(double));
+    MPI_Bcast(shm_Crds, crd_Displs[io.prm.num_Tetrads], MPI_DOUBLE, 0, leader_Comm);
+    sync_Node(crd_Win);
+    
+}
+
+
+
+void Master::reduce_Node_Forces(void) {
+    
+    int i, k, width = 3 * max_Atoms + 2;
+    int first = 0, last = num_Rows / node_Size;
+    
+    // Every process of the node sums up a slice of rows of the NB force arrays
+    // of the node into the array of the leader (master)
+    sync_Node(force_Win);
+    for (k = 1; k < node_Size; k++) {
+        for (i = first * width; i < last * width; i++) { node_Forces[0][i] += node_Forces[k][i]; }
+    }
+    sync_Node(force_Win);
+    
+    // A single reduction of every node to master
+    MPI_Reduce(MPI_IN_PLACE, &(NB_Forces[0][0]), num_Rows * width, MPI_DOUBLE, MPI_SUM, 0, leader_Comm);
+    
+}
+
+
+
 void Master::calculate_Forces(void) {
     
-    int i, j, rank, signal = TAG_FORCE;
-    MPI_Request send_Request[size - 1], recv_Request[io.prm.num_Tetrads];
-    MPI_Status send_Status[size - 1], recv_Status[io.prm.num_Tetrads];
+    int i, j, rank, reduced;
+    double share_Time[2] = { 0.0, 0.0 };
+    MPI_Request recv_Request[io.prm.num_Tetrads], crds_Request[size];
+    MPI_Request reduce_Request = MPI_REQUEST_NULL;
+    MPI_Status recv_Status[io.prm.num_Tetrads];
+    
+    // Reset the NB chunk counter before workers start taking chunks
+    if (io.nb_Schedule != 0) {
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, NB_Win);
+        NB_Counter = 0;
+        MPI_Win_unlock(0, NB_Win);
+    }
+    
+    // The NB forces are calculated at the first step after sync & the last step
+    // of every nb_Interval steps, and held in between (multiple time stepping)
+    i = md_Step % io.ntsync;
+    nb_Step = io.is_NB_Step(md_Step);
+    
+    // The energies are only calculated at the last step before they are written
+    energy_Step = (i == io.ntsync - 1 && (md_Step - i) % io.ntwt == 0);
+    
+    // Broadcast the header of the force calculation (with the coordinates when
+    // all workers need them). Otherwise broadcast the cooridnates to the NB
+    // group and send the ED group only the coordinates of their own tetrads,
+    // or send every worker its halo, or write them into the shared memory
+    send_Header(TAG_FORCE, (full_Frame ? ARG_FULL_FRAME : 0) | (nb_Step ? ARG_NB_FORCES : 0) |
+                           (energy_Step ? ARG_ENERGIES : 0));
+    if (io.shm_Node) {
+        share_Crds();
+    } else if (io.crd_Exchange) {
+        for (i = 0; i < size - 1; i++) {
+            crds_Request[i] = MPI_REQUEST_NULL;
+            if (MPI_Halo[i + 1] == MPI_DATATYPE_NULL) continue;
+            MPI_Isend(io.tetrad, 1, MPI_Halo[i + 1], i + 1, TAG_CRDS, comm, &(crds_Request[i]));
+        }
+        MPI_Waitall(size - 1, crds_Request, MPI_STATUSES_IGNORE);
+    } else {
+        reduced = io.crd_Precision && !full_Frame;
+        for (i = 0; i < size - 1; i++) {
+            crds_Request[i] = MPI_REQUEST_NULL;
+            if (MPI_ED_Crds[i + 1] == MPI_DATATYPE_NULL || (i >= ed_Group && !reduced)) continue;
+            MPI_Isend(&(io.tetrad[ED_Index[i + 1][0]]), 1, MPI_ED_Crds[i + 1], i + 1, TAG_CRDS, comm, &(crds_Request[i]));
+        }
+        if (reduced) {
+            encode_Crds();
+            MPI_Bcast(crd_Floats, num_Crds, MPI_FLOAT, 0, NB_Comm);
+        } else if (!header_Crds) {
+            MPI_Bcast(io.tetrad, 1, MPI_Crds, 0, NB_Comm);
+            if (io.crd_Precision == 2) memcpy(crd_Ref, io.tetrad[0].coordinates, num_Crds * sizeof(double));
+        }
+        MPI_Waitall(size - 1, crds_Request, MPI_STATUSES_IGNORE);
+    }
+    full_Frame = 0;
     
-    // Send a signle to indicate workers to prepare the force calculation
-    // Broadcast the cooridnates
-    for (i = 0; i < size - 1; i++) {
-        MPI_Isend(&signal, 1, MPI_INT, i + 1, TAG_FORCE, comm, &(send_Request[i]));
+    // The receives of the ED forces overwrite the (shaken) coordinates of tetrads,
+    // the NB share of master reads a copy taken before they are posted
+    if (io.master_Share > 0.0 && nb_Step && !io.bp_State) {
+        memcpy(share_Copy, io.tetrad[0].coordinates, num_Crds * sizeof(double));
     }
-    MPI_Bcast(io.tetrad, 1, MPI_Crds, 0, comm);
-    MPI_Waitall(size - 1, send_Request, send_Status);
     
-    // Receive all the ED forces from workers
+    // Receive all the ED forces from workers (except the ones of master, and none
+    // in the PC subspace)
     for (i = 0; i < io.prm.num_Tetrads; i++) {
+        recv_Request[i] = MPI_REQUEST_NULL;
+        if (io.pc_Integration || (i >= ED_Index[0][0] && i < ED_Index[0][0] + ED_Index[0][1])) continue;
         MPI_Irecv(&(io.tetrad[i]), 1, MPI_ED_Forces[i], MPI_ANY_SOURCE, TAG_ED + i, comm, &(recv_Request[i]));
     }
     
-    // Reduce & sum up the NB forces & process and assign the NB forces to tetrads
-    MPI_Reduce(MPI_IN_PLACE, &(NB_Forces[0][0]), io.prm.num_Tetrads * (3 * max_Atoms + 2), MPI_DOUBLE, MPI_SUM, 0, comm);
+    // Only the ED forces at the steps without NB forces (the NB forces of tetrads
+    // are held from the last calculation)
+    if (!nb_Step) {
+        if (io.master_Share > 0.0) calculate_ED_Share();
+        if (io.bp_State) accumulate_BP_Forces(recv_Request);
+        else MPI_Waitall(io.prm.num_Tetrads, recv_Request, recv_Status);
+        return;
+    }
+    
+    // Calculate the share of master (the NB forces first, so that the ED forces
+    // overlap the reduction)
+    if (io.master_Share > 0.0) {
+        if (!io.nb_Overlap) share_Time[0] = calculate_ED_Share();
+        share_Time[1] = calculate_NB_Share();
+    }
+    
+    // Start to reduce & sum up the NB forces (the touched rows of NB forces with
+    // the sparse reduction are received after the ED forces of master)
+    if (io.shm_Node) {
+        reduce_Node_Forces();
+    } else if (io.nb_Reduce == 0) {
+        MPI_Ireduce(MPI_IN_PLACE, &(NB_Forces[0][0]), num_Rows * (3 * max_Atoms + 2), MPI_DOUBLE, MPI_SUM, 0, NB_Comm, &reduce_Request);
+    }
+    if (io.master_Share > 0.0 && io.nb_Overlap) share_Time[0] = calculate_ED_Share();
+    
+    // Complete the reduction & process and assign the NB forces to tetrads
+    if (io.nb_Reduce == 0) {
+        MPI_Wait(&reduce_Request, MPI_STATUS_IGNORE);
+    } else {
+        recv_NB_Rows();
+    }
     process_NB_Forces();
-    MPI_Waitall(io.prm.num_Tetrads, recv_Request, recv_Status);
+    
+    // Accumulate the timings of workers piggybacked on the reduction (the ED
+    // group reduce their timings separately)
+    if (io.load_Balance) {
+        double * timings = &(NB_Forces[io.prm.num_Tetrads][0]);
+        if (ed_Group > 0) MPI_Reduce(MPI_IN_PLACE, timings, 2 * size, MPI_DOUBLE, MPI_SUM, 0, ED_Comm);
+        timings[0] = share_Time[0]; timings[1] = share_Time[1];
+        for (i = 0; i < size; i++) {
+            ED_Time[i] += timings[2 * i]; NB_Time[i] += timings[2*i+1];
+            timings[2 * i] = timings[2*i+1] = 0.0;
+        }
+        timed_Steps++;
+    }
+    if (io.bp_State) accumulate_BP_Forces(recv_Request);
+    else MPI_Waitall(io.prm.num_Tetrads, recv_Request, recv_Status);
+    
+}
+
+
+
+
+double Master::calculate_ED_Share(void) {
+    
+    double start_Time = MPI_Wtime();
+    
+    // Calculate the ED forces (the views of the single copy are shaken in place of
+    // the random terms, as the ones received from workers)
+    for (int i = ED_Index[0][0]; i < ED_Index[0][0] + ED_Index[0][1]; i++) {
+        if (io.bp_State) {
+            Tetrad t = io.tetrad[i];
+            memcpy(t.random_Terms, t.coordinates, 3 * t.num_Atoms * sizeof(double));
+            t.coordinates = t.random_Terms;
+            edmd.calculate_ED_Forces(&t, energy_Step);
+            continue;
+        }
+        edmd.calculate_ED_Forces(&(io.tetrad[i]), energy_Step);
+    }
+    
+    return MPI_Wtime() - start_Time;
     
 }
 
 
 
+double Master::calculate_NB_Share(void) {
+    
+    int chunk, one = 1;
+    double start_Time = MPI_Wtime();
+    
+    // Calculate the NB forces of the static range, or of the chunks taken from
+    // the counter as the workers do
+    if (io.nb_Schedule == 0) {
+        calculate_NB_Pairs(NB_Index[0][0], NB_Index[0][1]);
+    } else {
+        MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, NB_Win);
+        while (1) {
+            MPI_Fetch_and_op(&one, &chunk, MPI_INT, 0, 0, MPI_SUM, NB_Win);
+            MPI_Win_flush(0, NB_Win);
+            if (chunk >= num_Chunks) break;
+            calculate_NB_Pairs(NB_Chunks[chunk][0], NB_Chunks[chunk][1]);
+        }
+        MPI_Win_unlock(0, NB_Win);
+    }
+    
+    return MPI_Wtime() - start_Time;
+    
+}
+
+
+
+void Master::calculate_NB_Pairs(int start, int count) {
+    
+    int i, j, i1, i2;
+    Tetrad t1, t2;
+    
+    // The NB forces of the tetrads are only temporary here, they are assigned
+    // from the NB force array in process_NB_Forces() (the views of the single
+    // copy are read in place)
+    for (i = start; i < start + count; i++) {
+        
+        i1 = pair_Lists[i][0];
+        i2 = pair_Lists[i][1];
+        t1 = io.tetrad[i1]; t2 = io.tetrad[i2];
+        if (!io.bp_State) {
+            t1.coordinates = share_Copy + (t1.coordinates - io.tetrad[0].coordinates);
+            t2.coordinates = share_Copy + (t2.coordinates - io.tetrad[0].coordinates);
+        }
+        edmd.calculate_NB_Forces(&t1, &t2, energy_Step);
+        touched[i1] = touched[i2] = 1;
+        
+        // Sum up the NB forces of the specific tetrads
+        for (j = 0; j < 3 * t1.num_Atoms + 2; j++) {
+            NB_Forces[i1][j] += t1.NB_Forces[j];
+        }
+        for (j = 0; j < 3 * t2.num_Atoms + 2; j++) {
+            NB_Forces[i2][j] += t2.NB_Forces[j];
+        }
+    }
+    
+}
+
+
 
 void Master::process_NB_Forces(void) {
     
     int i, j;
+    
+    // The rows of tetrads are shared by the threads
+    #pragma omp parallel for private(j) schedule(static)
     for (i  = 0; i < io.prm.num_Tetrads; i++) {
-        for (j = 0; j < 3 * io.tetrad[i].num_Atoms; j++) {
-            
-            // Clip the NB forces between -1.0 and 1.0
-            if (NB_Forces[i][j] < -1.0)  NB_Forces[i][j]  =  -1.0;
-            else if (NB_Forces[i][j] > 1.0) NB_Forces[i][j] = 1.0;
-            
-            // Assign NB forces to tetrads
-            io.tetrad[i].NB_Forces[j] = NB_Forces[i][j];
-            
-            // Clear the NB force array for next use
-            NB_Forces[i][j] = 0.0;
-            
-        }
         
-        // NB energy & Electrostatic Energy
-        io.tetrad[i].NB_Forces[j]     = NB_Forces[i][j];
-        io.tetrad[i].NB_Forces[j + 1] = NB_Forces[i][j + 1];
+        // The rows untouched in the sparse reduction are still 0
+        if (io.nb_Reduce != 0 && !touched[i]) {
+            for (j = 0; j < 3 * io.tetrad[i].num_Atoms + 2; j++) { io.tetrad[i].NB_Forces[j] = 0.0; }
+            continue;
+        }
+        touched[i] = 0;
         
-        NB_Forces[i][j] = NB_Forces[i][j + 1] = 0.0;
+        // Clip & assign the NB forces to tetrads (the array is cleared)
+        edmd.assign_NB_Forces(&io.tetrad[i], NB_Forces[i]);
+    }
+    
+    // The NB forces of the single copy are summed up in the order of tetrads, and
+    // held as the ones of tetrads
+    if (io.bp_State) {
+        for (i = 0; i < num_BP_Crds; i++) { bp_NB[i] = 0.0; }
+        for (i = 0; i < io.prm.num_Tetrads; i++) { accumulate_BP_Rows(bp_NB, io.tetrad[i].NB_Forces, i); }
     }
     
 }
 
 
 
+void Master::recv_NB_Rows(void) {
+    
+    int i, nb_Size;
+    
+    MPI_Comm_size(NB_Comm, &nb_Size);
+    
+    if (io.nb_Reduce == 1) {
+        // Every worker of the NB group sends its rows to master
+        for (i = 0; i < nb_Size - 1; i++) { sum_NB_Rows(MPI_ANY_SOURCE); }
+    } else {
+        // The children of master in the binomial tree (ranks 1, 2, 4, ...)
+        for (i = 1; i < nb_Size; i <<= 1) { sum_NB_Rows(i); }
+    }
+    
+}
 
-void Master::update_Velocity(void) {
+
+
+void Master::sum_NB_Rows(int source) {
     
-    for (int i = 0; i < io.prm.num_Tetrads; i++) {
-        edmd.update_Velocities(&io.tetrad[i]);
+    int j, k, row, count, width = 3 * max_Atoms + 2;
+    MPI_Status recv_Status;
+    
+    // Every row is led by its index in the NB force array
+    MPI_Recv(NB_Rows, num_Rows * (width + 1), MPI_DOUBLE, source, TAG_NB, NB_Comm, &recv_Status);
+    MPI_Get_count(&recv_Status, MPI_DOUBLE, &count);
+    
+    for (j = 0; j < count; j += width + 1) {
+        row = (int) NB_Rows[j];
+        touched[row] = 1;
+        for (k = 0; k < width; k++) { NB_Forces[row][k] += NB_Rows[j + 1 + k]; }
     }
     
 }
 
 
 
-void Master::update_Coordinate(void) {
+void Master::integrate_Tetrads(void) {
     
-    for (int i = 0; i < io.prm.num_Tetrads; i++) {
-        edmd.update_Coordinates(&io.tetrad[i]);
+    int i;
+    MPI_Request recv_Request[io.prm.num_Tetrads];
+    MPI_Status recv_Status[io.prm.num_Tetrads];
+    
+    // Broadcast the number of steps with the velocities and the coordinates of
+    // all tetrads
+    send_Header(TAG_FORCE, io.ntsync);
+    md_Step += io.ntsync;
+    
+    // Receive the states of all tetrads after the steps
+    for (i = 0; i < io.prm.num_Tetrads; i++) {
+        MPI_Irecv(&(io.tetrad[i]), 1, MPI_State[i], MPI_ANY_SOURCE, TAG_ED + i, comm, &(recv_Request[i]));
     }
+    
+    // Accumulate the timings of workers over the steps
+    if (io.load_Balance) {
+        double * timings = &(NB_Forces[io.prm.num_Tetrads][0]);
+        for (i = 0; i < 2 * size; i++) { timings[i] = 0.0; }
+        MPI_Reduce(MPI_IN_PLACE, timings, 2 * size, MPI_DOUBLE, MPI_SUM, 0, comm);
+        for (i = 0; i < size; i++) {
+            ED_Time[i] += timings[2 * i]; NB_Time[i] += timings[2*i+1];
+            timings[2 * i] = timings[2*i+1] = 0.0;
+        }
+        timed_Steps += io.ntsync;
+    }
+    MPI_Waitall(io.prm.num_Tetrads, recv_Request, recv_Status);
+    
+}
 
+
+
+void Master::update_Velocity(void) {
+    
+    // The single copy of the base pairs
+    if (io.bp_State) {
+        integrate_BP_State();
+        md_Step++;
+        return;
+    }
+    
+    // The random terms are generated where they are used. In the PC subspace the
+    // whole step is integrated here (the coordinates are reconstructed for the next
+    // NB step). The tetrads are shared by the threads.
+    int nb_Next = io.is_NB_Step(md_Step + 1);
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < io.prm.num_Tetrads; i++) {
+        if (io.pc_Integration) {
+            edmd.integrate_PC(&io.tetrad[i], i, md_Step, nb_Step, nb_Next);
+            continue;
+        }
+        edmd.calculate_Random_Terms(&io.tetrad[i], i, md_Step);
+        edmd.update_Velocities(&io.tetrad[i]);
+    }
+    md_Step++;
+    
 }
 
 
 
-void Master::merge_Vels_n_Crds(void) {
+void Master::accumulate_BP_Rows(double* rows, double* values, int index) {
     
-    int i, j, index;
+    int j, g = io.displs[index];
     
-    // Initialise velocities & coordinates array
-    for (i = 0; i < 3 * io.crd.total_Atoms; i++) {
-        velocities[i] = coordinates[i] = 0.0;
+    for (j = 0; j < 3 * io.tetrad[index].num_Atoms; j++, g++) {
+        rows[g < num_BP_Crds ? g : g - num_BP_Crds] += values[j];
     }
     
-    // Gather all velocities & coordinates into a single array
-    for (i = 0; i < io.prm.num_Tetrads; i++) {
-        for (index = io.displs[i], j = 0; j < 3 * io.tetrad[i].num_Atoms; index++, j++) {
-            velocities [index] += io.tetrad[i].velocities [j];
-            coordinates[index] += io.tetrad[i].coordinates[j];
+}
+
+
+
+void Master::accumulate_BP_Forces(MPI_Request* recv_Request) {
+    
+    int i, next = 0, index;
+    
+    // The views are no longer read, the coordinates of the base pairs sum up the
+    // shaken coordinates of the views
+    for (i = 0; i < num_BP_Crds; i++) { coordinates[i] = bp_ED[i] = 0.0; }
+    
+    // Every tetrad is summed up as soon as it and all the tetrads before it have
+    // arrived, so the sums do not depend on the order of arrival (the ones of
+    // master are already complete)
+    while (next < io.prm.num_Tetrads) {
+        MPI_Waitany(io.prm.num_Tetrads, recv_Request, &index, MPI_STATUS_IGNORE);
+        for (; next < io.prm.num_Tetrads && recv_Request[next] == MPI_REQUEST_NULL; next++) {
+            accumulate_BP_Rows(bp_ED, io.tetrad[next].ED_Forces, next);
+            accumulate_BP_Rows(coordinates, io.tetrad[next].random_Terms, next);
         }
     }
     
-    // Process the first & last 3 tetrads
-    index = io.displs[io.crd.num_BP - 3];
-    for (i = 0; index < io.displs[io.crd.num_BP]; index++, i++) {
-        velocities [index] += velocities [i]; velocities [i] = velocities [index];
-        coordinates[index] += coordinates[i]; coordinates[i] = coordinates[index];
-    }
+}
 
-    // Divide velocities & coordinates by 4
-    for (i = 0; i < 3 * io.crd.total_Atoms; i++) {
-        velocities[i] *= 0.25; coordinates[i] *= 0.25;
+
+
+void Master::copy_BP_Tail(void) {
+    
+    // The last 3 base pairs are the first 3 (the views of the last 3 tetrads)
+    for (int i = num_BP_Crds; i < 3 * io.crd.total_Atoms; i++) {
+        velocities [i] = velocities [i - num_BP_Crds];
+        coordinates[i] = coordinates[i - num_BP_Crds];
     }
+    
+}
 
-    // Restore the velocities & coordinates back to tetrads
-    for (i = 0; i < io.prm.num_Tetrads; i++) {
-        for (index = io.displs[i], j = 0; j < 3 * io.tetrad[i].num_Atoms; index++, j++) {
-            io.tetrad[i].velocities [j] = velocities [index];
-            io.tetrad[i].coordinates[j] = coordinates[index];
+
+
+void Master::integrate_BP_State(void) {
+    
+    int b, g, j;
+    double kentic_Energy = 0.0, target_KE, tscal, temperature;
+    Tetrad * t;
+    
+    // Every coordinate of a base pair takes the mean of its four views (the shaken
+    // coordinates, the ED & NB forces), and its velocity is updated by simple
+    // Langevin dynamics. The random terms of a base pair are in the stream of its
+    // index, generated into the random terms of its first view (tetrad b).
+    #pragma omp parallel for private(g, j, t) schedule(dynamic)
+    for (b = 0; b < io.prm.num_Tetrads; b++) {
+        t = &(io.tetrad[b]);
+        edmd.rng.generate_Normals(t->random_Terms, 3 * io.crd.BP_Atoms[b], b, md_Step);
+        bp_KE[b] = 0.0;
+        for (g = io.displs[b], j = 0; g < io.displs[b + 1]; g++, j++) {
+            coordinates[g] *= 0.25;
+            velocities[g]   = (velocities[g] + 0.25 * bp_ED[g] * edmd.dt + (t->random_Terms[j] * t->noise_Factors[j] + 0.25 * bp_NB[g]) * edmd.dt * t->inv_Masses[j]) * edmd.gamfac;
+            bp_KE[b] += 0.5 * t->masses[j] * velocities[g] * velocities[g];
         }
     }
     
+    // Berendsen temperature control of the whole DNA (the kentic energies of the base
+    // pairs are summed up in order)
+    for (b = 0; b < io.prm.num_Tetrads; b++) { kentic_Energy += bp_KE[b]; }
+    target_KE = 0.5 * edmd.scaled * num_BP_Crds;
+    tscal = sqrt(1.0 + (edmd.dt / edmd.tautp) * ((target_KE / kentic_Energy) - 1.0));
+    temperature = kentic_Energy * 2 / (edmd.constants.Boltzmann * num_BP_Crds) * tscal * tscal;
+    
+    #pragma omp parallel for schedule(static)
+    for (g = 0; g < num_BP_Crds; g++) {
+        velocities[g]  *= tscal;
+        coordinates[g] += velocities[g] * edmd.dt;
+    }
+    copy_BP_Tail();
+    
+    for (b = 0; b < io.prm.num_Tetrads; b++) { io.tetrad[b].temperature = temperature; }
+    
 }
 
 
 
-void Master::write_Info(int istep) {
+void Master::update_Coordinate(void) {
     
-    double energies[4] = {0.0};
+    if (io.pc_Integration || io.bp_State) return;
     
-    // Gather energies & temperature of tetrads together
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < io.prm.num_Tetrads; i++) {
-        energies[0] += io.tetrad[i].ED_Forces[3 * io.tetrad[i].num_Atoms];
-        energies[1] += io.tetrad[i].NB_Forces[3 * io.tetrad[i].num_Atoms];
-        energies[2] += io.tetrad[i].NB_Forces[3 * io.tetrad[i].num_Atoms + 1];
-        energies[3] += io.tetrad[i].temperature;
+        edmd.update_Coordinates(&io.tetrad[i]);
     }
+
+}
+
+
+
+void Master::merge_Vels_n_Crds(void) {
     
-    // Calculate the average temperature of tetrads
-    energies[3] /= io.prm.num_Tetrads;
+    // The single copy of the base pairs is already merged
+    if (io.bp_State) return;
     
-    // Wrtie out energies
-    io.write_Energies(istep + io.ntsync, energies);
+    io.merge_Vels_n_Crds(velocities, coordinates, &edmd);
     
-    // Write trajectory
-    // io.displs[io.crd.num_BP - 3] is the index that the afterwards 3
-    // tetrads the same as the first three tetrads
-    io.write_Trajectory(istep, io.displs[io.crd.num_BP - 3], coordinates);
+}
+
+
+
+void Master::write_Info(int istep) {
+    
+    // Report the NB energy deviation of the reduced coordinate precision
+    if (io.crd_Validate) {
+        cout << ">>> Maximum relative NB energy deviation of the coordinate precision: "
+             << crd_Deviation << endl;
+        crd_Deviation = 0.0;
+    }
+    
+    // Write the energies & the trajectory
+    io.write_Info(istep, coordinates);
     
 }
 
@@ -422,14 +1376,8 @@ void Master::write_Crds(void) {
 
 void Master::finalise(void) {
     
-    MPI_Request send_Request[size - 1];
-    MPI_Status send_Status[size - 1];
-    
-    // Send the terminate signal to all workers
-    for (int signal = TAG_END, i = 0; i < size - 1; i++) {
-        MPI_Isend(&signal, 1, MPI_INT, i + 1, TAG_END, comm, &(send_Request[i]));
-    }
-    MPI_Waitall(size - 1, send_Request, send_Status);
+    // Send the terminate command to all workers
+    send_Header(TAG_END, 0);
     
 }
 
@@ -21,8 +21,13 @@
 #define master_hpp
 
 #include <iostream>
+#include <algorithm>
 #include "mpi.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "array.hpp"
 #include "mpilib.hpp"
 #include "edmd.hpp"
@@ -58,21 +63,116 @@ public:
     
     double ** pair_Lists; // The 2D array of NB pair lists
     
-    int    ** NB_Index;   // The workload distribution of NB force caulcaiton
+    int    ** NB_Index;   // The workload distribution of NB force caulcaiton (by rank)
+    
+    int    ** ED_Index;   // The workload distribution of ED force caulcaiton (by rank)
+    
+    double * ED_Weight;   // The weights of processes in the ED workload distribution
+    
+    double * NB_Weight;   // The weights of processes in the NB workload distribution
+    
+    int      ed_Group;    // The number of workers in the ED group (0: no groups)
+    
+    int      split_Group; // The ed_Group of the current ED & NB communicators (-1: none)
+    
+    int    ** NB_Chunks;  // The chunks of the pair lists for dynamic NB scheduling
+    
+    int      num_Chunks;  // The number of chunks of the pair lists
+    
+    int      NB_Counter;  // The index of the next NB chunk to be taken by workers
+    
+    double ** NB_Forces;  // The 2D array to store the NB forces (& timings of workers)
+    
+    int      num_Rows;    // The number of rows of the NB force array to be reduced
+    
+    double * NB_Rows;     // The touched rows of NB forces received (led by row index)
+    
+    int    * touched;     // Whether the rows of the NB force array are touched
+    
+    double * ED_Time;     // The measured time of ED force calculation of processes
     
-    int    ** ED_Index;   // The workload distribution of ED force caulcaiton
+    double * NB_Time;     // The measured time of NB force calculation of processes
     
-    double ** NB_Forces;  // The 2D array to store the NB forces
+    int    timed_Steps;   // The number of steps measured since the last sync
+    
+    int    md_Step;       // The number of steps integrated (the counter of the random terms)
     
     double * velocities;  // The velocities of the DNA
     
     double * coordinates; // The coordinates of the DNA
     
+    int      num_Crds;    // The number of coordinates of all tetrads
+    
+    int      num_BP_Crds;   // The number of coordinates of the base pairs (without the last 3
+                            // base pairs, the same as the first 3 of the circular DNA)
+    
+    double * bp_ED;         // The sums of the ED forces of the views of the base pairs (bp_State)
+    
+    double * bp_NB;         // The sums of the NB forces of the views of the base pairs (held)
+    
+    double * bp_KE;         // The kentic energies of the base pairs (summed up in order)
+    
+    int      full_Frame;  // Broadcast the coordinates in full precision (the first step after sync)
+    
+    int      nb_Step;     // Calculate the NB forces at this step (otherwise they are held)
+    
+    int      energy_Step; // Calculate the energies at this step (the last step before output)
+    
+    float  * crd_Floats;  // The coordinates (or the deltas) broadcast in reduced precision
+    
+    double * crd_Ref;     // The coordinates of the last full-precision frame (deltas)
+    
+    double * crd_Sent;    // The coordinates decoded by workers (validation)
+    
+    double   crd_Deviation; // The maximum relative NB energy deviation since the last report
+    
+    double * share_Copy;  // The coordinates the NB share of master reads (the receives of
+                          // the ED forces write the coordinates of tetrads meanwhile)
+    
     MPI_Comm comm;        // The MPI communicator
     
-    MPI_Datatype * MPI_ED_Forces; // For receiving ED forces & random terms
+    MPI_Comm ED_Comm;     // The communicator of master & the ED group
+    
+    MPI_Comm NB_Comm;     // The communicator of master & the NB group (or all workers)
+    
+    MPI_Comm node_Comm;   // The communicator of the processes of the node of master
+    
+    MPI_Comm leader_Comm; // The communicator of the leaders of nodes (master is rank 0)
+    
+    int      node_Size;   // The number of processes of the node of master
+    
+    int    * crd_Displs;  // The displacements of tetrads in the shared coordinates
+    
+    double * shm_Crds;    // The coordinates of all tetrads in the shared memory of the node
+    
+    double ** node_Forces; // The NB force arrays of the processes of the node (shared memory)
+    
+    MPI_Win  crd_Win;     // The shared memory window of the coordinates
+    
+    MPI_Win  force_Win;   // The shared memory window of the NB force arrays
+    
+    MPI_Datatype * MPI_ED_Forces; // For receiving ED forces (& the shaken coordinates)
     
     MPI_Datatype   MPI_Crds;      // For sending the coordinates of all tetrads
+    
+    MPI_Datatype * MPI_ED_Crds;   // For sending the coordinates of the tetrads of ED workers
+    
+    MPI_Datatype * MPI_Halo;      // For sending the coordinates of the halo of workers
+    
+    MPI_Win        NB_Win;        // For exposing the NB chunk counter to workers
+    
+    MPI_Datatype * MPI_State;     // For receiving the states of tetrads (distributed integration)
+    
+    MPI_Datatype   MPI_Vels_n_Crds; // For sending the velocities & coordinates of all tetrads
+    
+    int            header[2];     // The header of commands to workers (command & argument)
+    
+    int            header_Crds;   // Broadcast the coordinates with the header (0: no, 1: yes)
+    
+    MPI_Datatype   MPI_Header;    // For broadcasting the header with the coordinates (or the
+                                  // velocities & coordinates) of all tetrads
+    
+    MPI_Datatype   MPI_PC_Crds;   // For broadcasting the PC amplitudes & frames of all tetrads
 
     
     
@@ -126,32 +226,87 @@ public:
     void send_Tetrads(void);
     
     /**
-     * Function:  Calculate the center of mass (actually, centre of geom)
+     * Function:  Generate the pair lists of tetrads for non-bonded forces calculation
      *
-     * Parameter: double** com -> Center of mass
+     * Parameter: None
      *
      * Return:    None
      */
-    void cal_Centre_of_Mass(double** com);
+    void generate_Pair_Lists(void);
     
     /**
-     * Function:  Generate the pair lists of tetrads for non-bonded forces calculation
+     * Function:  Master divides the workload (according to the pair lists) of the ED and 
+     *            NB force calculation into similar size chunks.
      *
      * Parameter: None
      *
      * Return:    None
      */
-    void generate_Pair_Lists(void);
+    void generate_Indexes(void);
     
     /**
-     * Function:  Master divides the workload (according to the pair lists) of the ED and 
-     *            NB force calculation into similar size chunks.
+     * Function:  Divide the workload into chunks in proportion to the shares of
+     *            processes. The remaining works (from rounding) are assigned to
+     *            parts of the processes with a non-zero share.
+     *
+     * Parameter: int** index   -> The workload index (only the sizes are updated)
+     *            int total     -> The total workload to be divided
+     *            double* share -> The shares of processes
+     *
+     * Return:    None
+     */
+    void divide_Workload(int** index, int total, double* share);
+    
+    /**
+     * Function:  Shift the workload of processes towards equal measured time. Every
+     *            process gets a share of the workload proportional to its measured
+     *            rate (items per second) times its weight, damped by lb_Damping.
+     *
+     * Parameter: int** index    -> The workload index (only the sizes are updated)
+     *            int total      -> The total workload to be divided
+     *            double* time   -> The measured time of processes for the old index
+     *            double* weight -> The weights of processes
+     *
+     * Return:    None
+     */
+    void balance_Workload(int** index, int total, double* time, double* weight);
+    
+    /**
+     * Function:  Master cuts the pair lists into chunks for the dynamic NB schedules.
+     *            Chunks have a fixed size (nb_Chunk) for the dynamic schedule, and a
+     *            decreasing size (but not less than nb_Chunk) for the guided schedule.
      *
      * Parameter: None
      *
      * Return:    None
      */
-    void generate_Indexes(void);
+    void generate_Chunks(void);
+    
+    /**
+     * Function:  Master reorders the pair lists so that the pairs of every worker
+     *            (NB_Index) are spatially close, and touch as few tetrads as possible.
+     *            The pairs are divided by recursive coordinate bisection of their
+     *            midpoints.
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void partition_Pairs(void);
+    
+    /**
+     * Function:  Divide the pairs of ranks [w0, w1) into two spatial halves along
+     *            the longest axis of their bounding box, and recurse on both halves.
+     *
+     * Parameter: int* order   -> The order of the pairs, reordered in place
+     *            int first    -> The index of the first pair of rank w0 in order
+     *            int w0       -> The first rank
+     *            int w1       -> The last rank (exclusive)
+     *            double** mid -> The midpoints of the pairs
+     *
+     * Return:    None
+     */
+    void bisect_Pairs(int* order, int first, int w0, int w1, double** mid);
     
     /**
      * Function:  Master sends the pair lsit, workload index to all workers
@@ -161,13 +316,121 @@ public:
      * Return:    None
      */
     void send_Workload_Indexes(void);
-
+    
+    /**
+     * Function:  Broadcast the header of a command to workers. The coordinates of
+     *            all tetrads (or the velocities & coordinates with the distributed
+     *            integration) are in the same message of a force command when every
+     *            worker needs them (TAG_PAIRS & TAG_END are the bare header).
+     *
+     * Parameter: int command  -> The command (TAG_PAIRS, TAG_FORCE or TAG_END)
+     *            int argument -> The argument of the command (e.g. the number of steps)
+     *
+     * Return:    None
+     */
+    void send_Header(int command, int argument);
+    
+    /**
+     * Function:  Encode the coordinates of all tetrads in reduced precision (float,
+     *            or float deltas from the last full-precision frame). With the
+     *            validation, the NB energy of the coordinates decoded by workers is
+     *            compared with the one of the full-precision coordinates.
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void encode_Crds(void);
+    
+    /**
+     * Function:  Calculate the NB energy (NB & electrostatic) of all pairs of the
+     *            pair lists with a set of coordinates of all tetrads
+     *
+     * Parameter: double* crds -> The coordinates of all tetrads (contiguous)
+     *
+     * Return:    The NB energy
+     */
+    double calculate_NB_Energy(double* crds);
+    
+    /**
+     * Function:  Master decides the number of workers in the ED group. The rest
+     *            of the workers are in the NB group. With ed_Workers = -1 the ratio
+     *            follows the measured ED/NB time of the groups (with load balancing),
+     *            or the estimated flops of ED/NB force calculation. The weights of
+     *            processes in the ED & NB workload distribution are also set.
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void tune_Groups(void);
+    
+    /**
+     * Function:  Split the workers into the ED & NB groups (communicators), and
+     *            create the MPI_Datatype of the coordinates of every ED worker.
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void setup_Groups(void);
+    
+    /**
+     * Function:  Master creates the MPI_Datatype of the halo of every worker, which
+     *            are the tetrads the worker needs for its ED & NB force calculation
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void setup_Halo(void);
+    
+    /**
+     * Function:  Allocate the coordinates of all tetrads (one array per node) and
+     *            the NB force arrays of processes in the shared memory of nodes
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void setup_Shared(void);
+    
+    /**
+     * Function:  Synchronise the shared memory of a window among the processes of
+     *            the node
+     *
+     * Parameter: MPI_Win win -> The shared memory window
+     *
+     * Return:    None
+     */
+    void sync_Node(MPI_Win win);
+    
+    /**
+     * Function:  Master writes the coordinates of all tetrads into the shared memory
+     *            of its node, and broadcasts them to the leaders of other nodes
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void share_Crds(void);
+    
+    /**
+     * Function:  Sum up the NB force arrays of the node in the shared memory (every
+     *            process takes a slice of rows), and reduce the sums of nodes
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void reduce_Node_Forces(void);
+    
     /**
      * Function:  Master send the calculationg signal & the coordinates of all tetrads
      *            to all workers, and the workers then can start the ED/NB force calculation 
      *            according to the workload index sent before. 
      *            The master then receive the ED forces & sum up the NB forces with
-     *            the MPI_Reduce operation.
+     *            the MPI_Ireduce operation (or the sparse reduction).
      *
      * Parameter: None
      *
@@ -175,6 +438,38 @@ public:
      */
     void calculate_Forces(void);
     
+    /**
+     * Function:  Master calculates its own share of the ED forces
+     *            (when master_Share is not 0)
+     *
+     * Parameter: None
+     *
+     * Return:    The elapsed time
+     */
+    double calculate_ED_Share(void);
+    
+    /**
+     * Function:  Master calculates its own share of the NB forces (when master_Share
+     *            is not 0)
+     *
+     * Parameter: None
+     *
+     * Return:    The elapsed time
+     */
+    double calculate_NB_Share(void);
+    
+    /**
+     * Function:  Master computes the NB forces of a contiguous range of the pair lists
+     *            and sums them up into the NB force array. The coordinates are read
+     *            from the copy taken before the receives of the ED forces are posted.
+     *
+     * Parameter: int start -> The index of the first pair
+     *            int count -> The number of pairs
+     *
+     * Return:    None
+     */
+    void calculate_NB_Pairs(int start, int count);
+    
     /**
      * Function:  Clip the NB forces into range (-1.0, 1.0) & assign NB forces to tetrads
      *
@@ -184,6 +479,39 @@ public:
      */
     void process_NB_Forces(void);
     
+    /**
+     * Function:  Receive the touched rows of NB forces from every worker of the NB
+     *            group (or from the children of master in the reduction tree) & sum
+     *            them up into the NB force array.
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void recv_NB_Rows(void);
+    
+    /**
+     * Function:  Receive a message of touched rows of NB forces & sum them up into
+     *            the NB force array. The rows are marked as touched.
+     *
+     * Parameter: int source -> The rank (in NB_Comm) of the sender, or MPI_ANY_SOURCE
+     *
+     * Return:    None
+     */
+    void sum_NB_Rows(int source);
+    
+    /**
+     * Function:  Workers integrate the tetrads of their own (ED_Index) for ntsync
+     *            steps (the distributed integration). Master sends the velocities
+     *            & coordinates of all tetrads before the steps, and receives the
+     *            states of all tetrads after the steps.
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void integrate_Tetrads(void);
+    
     /**
      * Function:  Master calculates the velocities of all tetrads
      *
@@ -193,6 +521,51 @@ public:
      */
     void update_Velocity(void);
     
+    /**
+     * Function:  Master adds the values of a tetrad to the rows of its base pairs
+     *            (the last 3 base pairs are the first 3)
+     *
+     * Parameter: double* rows   -> The rows of the base pairs
+     *            double* values -> The values of the tetrad
+     *            int index      -> The index of the tetrad
+     *
+     * Return:    None
+     */
+    void accumulate_BP_Rows(double* rows, double* values, int index);
+    
+    /**
+     * Function:  Master completes the receives of the ED forces & shaken coordinates,
+     *            and sums them up into the base pairs in the order of tetrads as they
+     *            arrive (bp_State)
+     *
+     * Parameter: MPI_Request* recv_Request -> The receives of the ED forces
+     *
+     * Return:    None
+     */
+    void accumulate_BP_Forces(MPI_Request* recv_Request);
+    
+    /**
+     * Function:  Master copies the first 3 base pairs into the last 3 (bp_State)
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void copy_BP_Tail(void);
+    
+    /**
+     * Function:  Master integrates the single copy of the base pairs (bp_State). Every
+     *            coordinate takes the mean of the shaken coordinates, the ED forces
+     *            & the NB forces of its four views at every step, and the Berendsen
+     *            temperature control applies to the whole DNA. The views of tetrads
+     *            see the new coordinates in place.
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void integrate_BP_State(void);
+    
     /**
      * Function:  Master calculates the coordinates of all tetrads
      *
@@ -204,7 +577,9 @@ public:
     
     /**
      * Function:  Master merges the velocities & coordinates of tetrad together
-     *            & divide them by 4 (as they are fourfold overlapped)
+     *            & divide them by 4 (as they are fourfold overlapped). Every
+     *            coordinate of the DNA sums up its sources in the order of tetrads,
+     *            so the merge is the same with any number of threads.
      *
      * Parameter: None
      *
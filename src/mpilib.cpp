@@ -20,10 +20,30 @@
 #include "mpilib.hpp"
 
 
+void MPI_Lib::create_MPI_Blocks(MPI_Datatype* MPI_Blocks, int count, int* counts, MPI_Aint* displs) {
+    
+    int i, blocks = 0;
+    
+    // Merge the blocks which are adjacent in memory (the arrays of tetrads are
+    // in contiguous buffers), e.g. the coordinates of all tetrads are one block
+    for (i = 0; i < count; i++) {
+        if (blocks > 0 && displs[blocks - 1] + (MPI_Aint) (counts[blocks - 1] * sizeof(double)) == displs[i]) {
+            counts[blocks - 1] += counts[i];
+        } else {
+            counts[blocks] = counts[i]; displs[blocks] = displs[i]; blocks++;
+        }
+    }
+    
+    MPI_Type_create_hindexed(blocks, counts, displs, MPI_DOUBLE, MPI_Blocks);
+    MPI_Type_commit(MPI_Blocks);
+    
+}
+
+
+
 void MPI_Lib::create_MPI_Tetrad(MPI_Datatype* MPI_Tetrad, int num_Tetrads, Tetrad* tetrad) {
     
-    int i, j, * counts = new int [5 * num_Tetrads];
-    MPI_Datatype * old_Types = new MPI_Datatype [5 * num_Tetrads];
+    int i, * counts = new int [5 * num_Tetrads];
     MPI_Aint base,  * displs = new MPI_Aint [5 * num_Tetrads];
     
     for (i = 0; i < num_Tetrads; i++) {
@@ -35,9 +55,6 @@ void MPI_Lib::create_MPI_Tetrad(MPI_Datatype* MPI_Tetrad, int num_Tetrads, Tetra
         counts[5*i+3] = tetrad[i].num_Evecs;
         counts[5*i+4] = tetrad[i].num_Evecs * (3 * tetrad[i].num_Atoms);
         
-        // The original data type of the arrays
-        for (j = 0; j < 5; j++) { old_Types[5*i+j] = MPI_DOUBLE; }
-        
         // Get the memory address of every elements in tetrad
         MPI_Get_address(&(tetrad[i].avg[0]),             &displs[5 * i]);
         MPI_Get_address(&(tetrad[i].masses[0]),          &displs[5*i+1]);
@@ -52,11 +69,9 @@ void MPI_Lib::create_MPI_Tetrad(MPI_Datatype* MPI_Tetrad, int num_Tetrads, Tetra
     for (i = 5 * num_Tetrads - 1; i >= 0; i--) { displs[i] -= base; }
     
     // Create the MPI data type "MPI_Tetrad".
-    MPI_Type_create_struct(5 * num_Tetrads, counts, displs, old_Types, MPI_Tetrad);
-    MPI_Type_commit(MPI_Tetrad);
+    create_MPI_Blocks(MPI_Tetrad, 5 * num_Tetrads, counts, displs);
     
     delete [] counts;
-    delete [] old_Types;
     delete [] displs;
 
 }
@@ -73,23 +88,20 @@ void MPI_Lib::free_MPI_Tetrad(MPI_Datatype* MPI_Tetrad) {
 
 void MPI_Lib::create_MPI_ED_Forces(MPI_Datatype* MPI_ED_Forces, Tetrad* tetrad) {
     
-    int i, counts[3];
-    MPI_Datatype old_Types[3] = {MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE};
-    MPI_Aint base, displs[3];
+    int i, counts[2];
+    MPI_Aint base, displs[2];
     
+    // The random terms are generated where the tetrad is integrated
     counts[0] = 3 * tetrad->num_Atoms + 1; // ED
     counts[1] = 3 * tetrad->num_Atoms;     // Crds
-    counts[2] = 3 * tetrad->num_Atoms;     // random
     
     MPI_Get_address(tetrad, &base);
     MPI_Get_address(&(tetrad->ED_Forces[0]),    &displs[0]);
     MPI_Get_address(&(tetrad->coordinates[0]),  &displs[1]);
-    MPI_Get_address(&(tetrad->random_Terms[0]), &displs[2]);
     
-    for (i = 2; i >= 0; i--) { displs[i] -= base; }
+    for (i = 1; i >= 0; i--) { displs[i] -= base; }
     
-    MPI_Type_create_struct(3, counts, displs, old_Types, MPI_ED_Forces);
-    MPI_Type_commit(MPI_ED_Forces);
+    create_MPI_Blocks(MPI_ED_Forces, 2, counts, displs);
     
 }
 
@@ -106,13 +118,11 @@ void MPI_Lib::free_MPI_ED_Forces(MPI_Datatype* MPI_ED_Forces) {
 void MPI_Lib::create_MPI_Crds(MPI_Datatype* MPI_Crds, int num_Tetrads, Tetrad* tetrad) {
     
     int i, * counts = new int [num_Tetrads];
-    MPI_Datatype * old_Types = new MPI_Datatype [num_Tetrads];
     MPI_Aint base,  * displs = new MPI_Aint [num_Tetrads];
     
     for (i = 0; i < num_Tetrads; i++) {
         
         counts[i] = 3 * tetrad[i].num_Atoms;
-        old_Types[i] = MPI_DOUBLE;
         MPI_Get_address(&(tetrad[i].coordinates[0]), &displs[i]);
         
     }
@@ -120,11 +130,9 @@ void MPI_Lib::create_MPI_Crds(MPI_Datatype* MPI_Crds, int num_Tetrads, Tetrad* t
     MPI_Get_address(&(tetrad[0]), &base);
     for (i = num_Tetrads - 1; i >= 0; i--) { displs[i] -= base; }
     
-    MPI_Type_create_struct(num_Tetrads, counts, displs, old_Types, MPI_Crds);
-    MPI_Type_commit(MPI_Crds);
+    create_MPI_Blocks(MPI_Crds, num_Tetrads, counts, displs);
     
     delete [] counts;
-    delete [] old_Types;
     delete [] displs;
     
 }
@@ -139,5 +147,152 @@ void MPI_Lib::free_MPI_Crds(MPI_Datatype* MPI_Crds) {
 
 
 
+void MPI_Lib::create_MPI_Halo(MPI_Datatype* MPI_Halo, int count, int* list, Tetrad* tetrad) {
+    
+    int i, * counts = new int [count];
+    MPI_Aint base,  * displs = new MPI_Aint [count];
+    
+    for (i = 0; i < count; i++) {
+        
+        counts[i] = 3 * tetrad[list[i]].num_Atoms;
+        MPI_Get_address(&(tetrad[list[i]].coordinates[0]), &displs[i]);
+        
+    }
+    
+    MPI_Get_address(&(tetrad[0]), &base);
+    for (i = count - 1; i >= 0; i--) { displs[i] -= base; }
+    
+    create_MPI_Blocks(MPI_Halo, count, counts, displs);
+    
+    delete [] counts;
+    delete [] displs;
+    
+}
+
+
+
+int MPI_Lib::list_Halo(int r, int** ED_Index, int** NB_Index, double** pair_Lists, int* list, int* mark) {
+    
+    int i, k, t, count = 0;
+    
+    // The tetrads of the ED forces
+    for (i = ED_Index[r][0]; i < ED_Index[r][0] + ED_Index[r][1]; i++) {
+        mark[i] = r; list[count++] = i;
+    }
+    
+    // The tetrads of the NB pairs
+    for (i = NB_Index[r][0]; i < NB_Index[r][0] + NB_Index[r][1]; i++) {
+        for (k = 0; k < 2; k++) {
+            t = (int) pair_Lists[i][k];
+            if (mark[t] != r) { mark[t] = r; list[count++] = t; }
+        }
+    }
+    
+    sort(list, list + count);
+    
+    return count;
+    
+}
+
+
+
+void MPI_Lib::create_MPI_PC_Crds(MPI_Datatype* MPI_PC_Crds, int num_Tetrads, Tetrad* tetrad) {
+    
+    int i, * counts = new int [num_Tetrads];
+    MPI_Aint base,  * displs = new MPI_Aint [num_Tetrads];
+    
+    // The amplitudes & the frame lead the PC state of a tetrad
+    for (i = 0; i < num_Tetrads; i++) {
+        
+        counts[i] = tetrad[i].num_Evecs + PC_FRAME;
+        MPI_Get_address(&(tetrad[i].pc_State[0]), &displs[i]);
+        
+    }
+    
+    MPI_Get_address(&(tetrad[0]), &base);
+    for (i = num_Tetrads - 1; i >= 0; i--) { displs[i] -= base; }
+    
+    create_MPI_Blocks(MPI_PC_Crds, num_Tetrads, counts, displs);
+    
+    delete [] counts;
+    delete [] displs;
+    
+}
+
+
+
+void MPI_Lib::create_MPI_Header(MPI_Datatype* MPI_Header, int* header, MPI_Datatype payload, Tetrad* tetrad) {
+    
+    int counts[2] = { 2, 1 };
+    MPI_Datatype old_Types[2] = { MPI_INT, payload };
+    MPI_Aint base, displs[2];
+    
+    // The displacement of the header is relative to the tetrad array (as the payload)
+    MPI_Get_address(header, &displs[0]);
+    MPI_Get_address(&(tetrad[0]), &base);
+    displs[0] -= base; displs[1] = 0;
+    
+    MPI_Type_create_struct(2, counts, displs, old_Types, MPI_Header);
+    MPI_Type_commit(MPI_Header);
+    
+}
+
+
+
+void MPI_Lib::create_MPI_Vels_n_Crds(MPI_Datatype* MPI_Vels_n_Crds, int num_Tetrads, Tetrad* tetrad) {
+    
+    int i, * counts = new int [2 * num_Tetrads];
+    MPI_Aint base,  * displs = new MPI_Aint [2 * num_Tetrads];
+    
+    // The velocities of all tetrads, then the coordinates of all tetrads
+    for (i = 0; i < num_Tetrads; i++) {
+        
+        counts[i] = counts[num_Tetrads + i] = 3 * tetrad[i].num_Atoms;
+        MPI_Get_address(&(tetrad[i].velocities[0]),  &displs[i]);
+        MPI_Get_address(&(tetrad[i].coordinates[0]), &displs[num_Tetrads + i]);
+        
+    }
+    
+    MPI_Get_address(&(tetrad[0]), &base);
+    for (i = 2 * num_Tetrads - 1; i >= 0; i--) { displs[i] -= base; }
+    
+    create_MPI_Blocks(MPI_Vels_n_Crds, 2 * num_Tetrads, counts, displs);
+    
+    delete [] counts;
+    delete [] displs;
+    
+}
+
+
+
+void MPI_Lib::create_MPI_State(MPI_Datatype* MPI_State, Tetrad* tetrad) {
+    
+    int i, counts[5];
+    MPI_Aint base, displs[5];
+    
+    counts[0] = 3 * tetrad->num_Atoms; // Vels
+    counts[1] = 3 * tetrad->num_Atoms; // Crds
+    counts[2] = 1;                     // ED energy
+    counts[3] = 2;                     // NB & Electrostatic energy
+    counts[4] = 1;                     // Temperature
+    
+    MPI_Get_address(tetrad, &base);
+    MPI_Get_address(&(tetrad->velocities[0]),                    &displs[0]);
+    MPI_Get_address(&(tetrad->coordinates[0]),                   &displs[1]);
+    MPI_Get_address(&(tetrad->ED_Forces[3 * tetrad->num_Atoms]), &displs[2]);
+    MPI_Get_address(&(tetrad->NB_Forces[3 * tetrad->num_Atoms]), &displs[3]);
+    MPI_Get_address(&(tetrad->temperature),                      &displs[4]);
+    
+    for (i = 4; i >= 0; i--) { displs[i] -= base; }
+    
+    create_MPI_Blocks(MPI_State, 5, counts, displs);
+    
+}
+
 
 
+void MPI_Lib::free_MPI_State(MPI_Datatype* MPI_State) {
+    
+    MPI_Type_free(MPI_State);
+    
+}
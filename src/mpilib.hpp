@@ -22,6 +22,7 @@
 
 #include <iostream>
 #include <cstddef>
+#include <algorithm>
 #include "mpi.h"
 
 #include "tetrad.hpp"
@@ -30,11 +31,23 @@
 // MPI tags for message passing
 #define TAG_DATA   1  // For passing the EDMD simulation parameters
 #define TAG_TETRAD 2  // For passing the tetrads from master to workers
-#define TAG_PAIRS  3  // For passing the pair list and displacements of workload
-#define TAG_END    6  // For terminating simualtion
-#define TAG_FORCE  7  // For ED and NB force calculation
-#define TAG_NB     8  // For NB force calculation
-#define TAG_ED     9  // For ED force calculation
+#define TAG_PAIRS  3  // For passing the pair list and displacements of workload (and
+                      // the command of the header)
+#define TAG_END    6  // For terminating simualtion (command of the header)
+#define TAG_FORCE  7  // For ED and NB force calculation (command of the header)
+#define TAG_NB     8  // For NB force calculation (the touched rows of NB forces)
+#define TAG_ED     9  // For ED force calculation (TAG_ED + i for tetrad i, workers -> master),
+                      // or the state of tetrad i with the distributed integration
+#define TAG_CRDS  10  // For the coordinates of the tetrads of ED workers (master -> workers),
+                      // or the halo of coordinates (master/workers -> workers)
+
+// The flags of the argument of the force command (with the master integration)
+#define ARG_FULL_FRAME 1  // The coordinates are broadcast in full precision
+#define ARG_NB_FORCES  2  // The NB forces are calculated (otherwise only the ED forces)
+#define ARG_ENERGIES   4  // The energies are calculated with the forces (for the output)
+
+// The number of the EDMD simulation parameters broadcast to workers
+#define NUM_PARA  26
 
 
 using namespace std;
@@ -48,6 +61,19 @@ class MPI_Lib{
     
 public:
     
+    /**
+     * Function:  Create the MPI_Datatype of blocks of doubles (relative to the tetrad
+     *            array). The blocks adjacent in memory are merged into one block.
+     *
+     * Parameter: MPI_Datatype* MPI_Blocks -> The MPI data type of the blocks
+     *            int count                -> The number of blocks
+     *            int* counts              -> The number of doubles of the blocks (merged)
+     *            MPI_Aint* displs         -> The displacements of the blocks (merged)
+     *
+     * Return:    None
+     */
+    static void create_MPI_Blocks(MPI_Datatype* MPI_Blocks, int count, int* counts, MPI_Aint* displs);
+    
     /**
      * Function:  Create the MPI_Datatype for passing the tetrad parameters
      *
@@ -107,6 +133,93 @@ public:
      */
     static void free_MPI_Crds(MPI_Datatype* MPI_Crds);
     
+    /**
+     * Function:  Create the MPI_Datatype for passing the coordinates of a list of
+     *            tetrads (the halo of a process)
+     *
+     * Parameter: MPI_Datatype* MPI_Halo -> The MPI data type of coordinates
+     *            int count              -> The number of tetrads in the list
+     *            int* list              -> The indexes of the tetrads
+     *            Tetrad* tetrad         -> The tetrad array
+     *
+     * Return:    None
+     */
+    static void create_MPI_Halo(MPI_Datatype* MPI_Halo, int count, int* list, Tetrad* tetrad);
+    
+    /**
+     * Function:  List the tetrads needed by a process: the tetrads of its ED range
+     *            and the tetrads of its NB pairs (sorted by index). Master & workers
+     *            list the halos with this function, so they agree on them.
+     *
+     * Parameter: int r               -> The rank of the process
+     *            int** ED_Index      -> The ED ranges of processes (first, count)
+     *            int** NB_Index      -> The NB ranges of processes in the pair lists
+     *            double** pair_Lists -> The pair lists of tetrads
+     *            int* list           -> The list of tetrads (output)
+     *            int* mark           -> The marks of listed tetrads (not equal to r initially)
+     *
+     * Return:    The number of tetrads in the list
+     */
+    static int list_Halo(int r, int** ED_Index, int** NB_Index, double** pair_Lists, int* list, int* mark);
+    
+    /**
+     * Function:  Create the MPI_Datatype for passing the PC amplitudes & the frames
+     *            of all tetrads (the coordinates are reconstructed from them)
+     *
+     * Parameter: MPI_Datatype* MPI_PC_Crds -> The MPI data type of the PC amplitudes & frames
+     *            int num_Tetrads           -> The number of tetrads
+     *            Tetrad* tetrad            -> The tetrad array
+     *
+     * Return:    None
+     */
+    static void create_MPI_PC_Crds(MPI_Datatype* MPI_PC_Crds, int num_Tetrads, Tetrad* tetrad);
+    
+    /**
+     * Function:  Create the MPI_Datatype for passing the header of a command (the
+     *            command & its argument) together with a payload of tetrads (e.g.
+     *            the coordinates of all tetrads) in a single message
+     *
+     * Parameter: MPI_Datatype* MPI_Header -> The MPI data type of the header & payload
+     *            int* header              -> The header (2 integers)
+     *            MPI_Datatype payload     -> The MPI data type of the payload
+     *            Tetrad* tetrad           -> The tetrad array
+     *
+     * Return:    None
+     */
+    static void create_MPI_Header(MPI_Datatype* MPI_Header, int* header, MPI_Datatype payload, Tetrad* tetrad);
+    
+    /**
+     * Function:  Create the MPI_Datatype for passing the velocities & coordinates of
+     *            all tetrads
+     *
+     * Parameter: MPI_Datatype* MPI_Vels_n_Crds -> The MPI data type of velocities & coordinates
+     *            int num_Tetrads               -> The number of tetrads
+     *            Tetrad* tetrad                -> The tetrad array
+     *
+     * Return:    None
+     */
+    static void create_MPI_Vels_n_Crds(MPI_Datatype* MPI_Vels_n_Crds, int num_Tetrads, Tetrad* tetrad);
+    
+    /**
+     * Function:  Create the MPI_Datatype for passing the state of a tetrad integrated
+     *            by a worker (velocities, coordinates, energies & temperature)
+     *
+     * Parameter: MPI_Datatype* MPI_State -> The MPI data type of the state
+     *            Tetrad* tetrad          -> The tetrad whose state to be passed
+     *
+     * Return:    None
+     */
+    static void create_MPI_State(MPI_Datatype* MPI_State, Tetrad* tetrad);
+    
+    /**
+     * Function:  Free the MPI_Datatype "MPI_Vels_n_Crds" or "MPI_State"
+     *
+     * Parameter: MPI_Datatype* MPI_State -> The MPI data type to be freed
+     *
+     * Return:    None
+     */
+    static void free_MPI_State(MPI_Datatype* MPI_State);
+    
 };
 
 
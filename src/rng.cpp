@@ -0,0 +1,108 @@
+/********************************************************************************
+ *                                                                              *
+ *          Porting the Essential Dynamics/Molecular Dynamics method            *
+ *             for large-scale nucleic acid simulations to ARCHER               *
+ *                                                                              *
+ *                               Zhuowei Si                                     *
+ *              EPCC supervisors: Elena Breitmoser, Iain Bethune                *
+ *     External supervisor: Charlie Laughton (The University of Nottingham)     *
+ *                                                                              *
+ *                  MSc in High Performance Computing, EPCC                     *
+ *                       The University of Edinburgh                            *
+ *                                                                              *
+ *******************************************************************************/
+
+/**
+ * File:  rng.cpp
+ * Brief: The implementation of the RNG class for the counter-based random numbers
+ */
+
+#include "rng.hpp"
+
+// The multipliers & the Weyl sequence of the key of Philox4x32
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+
+// 2^-32, the uniform numbers are (random + 1) * 2^-32 in (0, 1]
+#define UNIFORM_SCALE 2.3283064365386963e-10
+
+
+
+RNG::RNG(void) {
+    
+    seed = 13579;
+    
+}
+
+
+
+void RNG::generate_Normals(double* normals, int count, unsigned int stream, unsigned int step) {
+    
+    int i, j, full = count - count % 4;
+    unsigned int counter[4], key[2], random[4];
+    double tail[4];
+    
+    key[0] = seed; key[1] = stream;
+    
+    // The uniform numbers of the full blocks of 4 (the block & the step are the counter)
+    for (i = 0; i < full; i += 4) {
+        counter[0] = i / 4; counter[1] = step; counter[2] = counter[3] = 0;
+        philox_4x32(counter, key, random);
+        for (j = 0; j < 4; j++) { normals[i + j] = (random[j] + 1.0) * UNIFORM_SCALE; }
+    }
+    box_Muller(normals, full);
+    
+    // The last block (a part of it is used)
+    if (full < count) {
+        counter[0] = full / 4; counter[1] = step; counter[2] = counter[3] = 0;
+        philox_4x32(counter, key, random);
+        for (j = 0; j < 4; j++) { tail[j] = (random[j] + 1.0) * UNIFORM_SCALE; }
+        box_Muller(tail, 4);
+        for (j = 0; j < count - full; j++) { normals[full + j] = tail[j]; }
+    }
+    
+}
+
+
+
+void RNG::philox_4x32(unsigned int* counter, unsigned int* key, unsigned int* random) {
+    
+    int i;
+    unsigned int c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    unsigned int k0 = key[0], k1 = key[1];
+    unsigned long long p0, p1;
+    
+    for (i = 0; i < 10; i++) {
+        
+        p0 = (unsigned long long) PHILOX_M0 * c0;
+        p1 = (unsigned long long) PHILOX_M1 * c2;
+        
+        c0 = (unsigned int) (p1 >> 32) ^ c1 ^ k0;
+        c2 = (unsigned int) (p0 >> 32) ^ c3 ^ k1;
+        c1 = (unsigned int) p1;
+        c3 = (unsigned int) p0;
+        
+        // Bump the key
+        k0 += PHILOX_W0; k1 += PHILOX_W1;
+    }
+    
+    random[0] = c0; random[1] = c1; random[2] = c2; random[3] = c3;
+    
+}
+
+
+
+void RNG::box_Muller(double* numbers, int count) {
+    
+    double r, theta;
+    
+    for (int i = 0; i < count; i += 2) {
+        r     = sqrt(-2.0 * log(numbers[i]));
+        theta = 2.0 * M_PI * numbers[i + 1];
+        numbers[i]     = r * cos(theta);
+        numbers[i + 1] = r * sin(theta);
+    }
+    
+}
@@ -0,0 +1,90 @@
+/********************************************************************************
+ *                                                                              *
+ *          Porting the Essential Dynamics/Molecular Dynamics method            *
+ *             for large-scale nucleic acid simulations to ARCHER               *
+ *                                                                              *
+ *                               Zhuowei Si                                     *
+ *              EPCC supervisors: Elena Breitmoser, Iain Bethune                *
+ *     External supervisor: Charlie Laughton (The University of Nottingham)     *
+ *                                                                              *
+ *                  MSc in High Performance Computing, EPCC                     *
+ *                       The University of Edinburgh                            *
+ *                                                                              *
+ *******************************************************************************/
+
+/**
+ * File:  rng.hpp
+ * Brief: The declaration of the RNG class for the counter-based random numbers
+ */
+
+#ifndef rng_hpp
+#define rng_hpp
+
+#include <cmath>
+
+/**
+ * Brief: The counter-based random number generator (Philox4x32-10) of the random
+ *        terms. A stream (e.g. a tetrad) and a step select the counters, so the
+ *        numbers are reproducible by the seed, whichever process or thread
+ *        generates them, and the generator has no state to share.
+ */
+class RNG {
+    
+public:
+    
+    unsigned int seed; // The seed (the first word of the key of all streams)
+    
+public:
+    
+    /**
+     * Function:  The constructor of RNG class
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    RNG(void);
+    
+    /**
+     * Function:  Fill an array with normally distributed random numbers (zero mean
+     *            and unit variance). The uniform numbers are generated 4 at a time
+     *            by Philox4x32-10 and transformed in pairs by Box-Muller.
+     *
+     * Parameter: double* normals      -> The array of the random numbers
+     *            int count            -> The number of random numbers
+     *            unsigned int stream  -> The stream (the second word of the key)
+     *            unsigned int step    -> The step (a word of the counter)
+     *
+     * Return:    None
+     */
+    void generate_Normals(double* normals, int count, unsigned int stream, unsigned int step);
+    
+    /**
+     * Function:  The Philox4x32-10 block function (Salmon et al., "Parallel random
+     *            numbers: as easy as 1, 2, 3", SC11), public for its known-answer
+     *            check (bench/check_rng.cpp)
+     *
+     * Parameter: unsigned int* counter -> The 4 words of the counter
+     *            unsigned int* key     -> The 2 words of the key
+     *            unsigned int* random  -> The 4 random words
+     *
+     * Return:    None
+     */
+    static void philox_4x32(unsigned int* counter, unsigned int* key, unsigned int* random);
+    
+private:
+    
+    /**
+     * Function:  Transform pairs of uniform numbers in (0, 1] into pairs of normal
+     *            numbers in place (Box-Muller)
+     *
+     * Parameter: double* numbers -> The uniform numbers (the normal numbers on return)
+     *            int count       -> The number of numbers (even)
+     *
+     * Return:    None
+     */
+    static void box_Muller(double* numbers, int count);
+    
+};
+
+#endif /* rng_hpp */
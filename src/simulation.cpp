@@ -39,12 +39,19 @@ void master_Code(void) {
         master.generate_Indexes();
         master.send_Workload_Indexes();
         
-        for (int i = 0; i < master.io.ntsync; i++) {
+        if (master.io.integration) {
             
-            master.calculate_Forces();
-            master.update_Velocity();
-            master.update_Coordinate();
-    
+            master.integrate_Tetrads();
+            
+        } else {
+            
+            for (int i = 0; i < master.io.ntsync; i++) {
+                
+                master.calculate_Forces();
+                master.update_Velocity();
+                master.update_Coordinate();
+                
+            }
         }
     
         master.merge_Vels_n_Crds();
@@ -0,0 +1,520 @@
+/********************************************************************************
+ *                                                                              *
+ *          Porting the Essential Dynamics/Molecular Dynamics method            *
+ *             for large-scale nucleic acid simulations to ARCHER               *
+ *                                                                              *
+ *                               Zhuowei Si                                     *
+ *              EPCC supervisors: Elena Breitmoser, Iain Bethune                *
+ *     External supervisor: Charlie Laughton (The University of Nottingham)     *
+ *                                                                              *
+ *                  MSc in High Performance Computing, EPCC                     *
+ *                       The University of Edinburgh                            *
+ *                                                                              *
+ *******************************************************************************/
+
+/**
+ * File:  standalone.cpp
+ * Brief: The implementation of the Standalone class
+ */
+
+#include "standalone.hpp"
+
+
+Standalone::Standalone(void) {
+    
+    num_Threads = 1;
+    max_Atoms   = 0;
+    num_Pairs   = 0;
+    md_Step     = 0;
+    nb_Step     = 1;
+    energy_Step = 1;
+    num_Tiles   = 0;
+    pair_Capacity = 0;
+    
+}
+
+
+
+Standalone::~Standalone(void) {
+    
+    // Deallocate memory of arrays
+    array.deallocate_2D_Double_Array(pair_Lists);
+    if (!io.task_Graph) {
+        for (int i = 0; i < num_Threads; i++) {
+            array.deallocate_2D_Double_Array(thread_Forces[i]);
+        }
+        delete [] thread_Forces;
+        array.deallocate_2D_Double_Array(thread_Scratch);
+    }
+    delete [] velocities;
+    delete [] coordinates;
+    if (io.task_Graph) {
+        if (pair_Capacity > 0) array.deallocate_2D_Double_Array(pair_Forces);
+        delete [] pair_Displs;
+        delete [] pair_Sources;
+        delete [] tile_Displs;
+        delete [] tile_Tetrads;
+        delete [] tile_Pending;
+        delete [] tetrad_Displs;
+        delete [] tetrad_Tiles;
+        delete [] pending;
+    }
+    
+}
+
+
+
+void Standalone::initialise(void) {
+    
+    int i, j;
+    
+    // Read the comfiguration file, the tetrad parameter file, the coordinate
+    // file & Initialise the coordinates & velocities of tetrads
+    io.read_Cofig(&edmd);
+    io.read_Prm();
+    io.read_Crd();
+    io.initialise_Tetrad_Crds();
+    
+    // The single copy of the base pairs is a mode of master
+    if (io.bp_State) {
+        cout << ">>> WARNING: The standalone engine integrates the tetrads, bp_State disabled." << endl;
+        io.bp_State = 0;
+    }
+    
+    // The OpenMP threads of the engine (the threads of workers in the Config file)
+#ifdef _OPENMP
+    if (io.omp_Threads > 0) omp_set_num_threads(io.omp_Threads);
+    num_Threads = omp_get_max_threads();
+#endif
+    
+    // Inintialise the output frequencies
+    io.ntwt -= io.ntwt % io.ntsync; if (io.ntwt == 0) io.ntwt = 1;
+    io.ntpr -= io.ntpr % io.ntsync; if (io.ntpr == 0) io.ntpr = 1;
+    
+    // The seed of the random terms (a new one every run unless set in the Config file)
+    edmd.rng.seed = io.rng_Seed > 0 ? (unsigned int) io.rng_Seed : (unsigned int) time(NULL);
+    
+    // The integration constants of tetrads
+    edmd.initialise_Constants(io.tetrad, io.prm.num_Tetrads);
+    
+    // The states of tetrads in the PC subspace (the coordinates in the subspace)
+    if (io.pc_Integration) {
+        for (i = 0; i < io.prm.num_Tetrads; i++) {
+            edmd.initialise_PC_State(&io.tetrad[i]);
+            edmd.reconstruct_Crds(&io.tetrad[i]);
+        }
+    }
+    
+    for (i = 0; i < io.prm.num_Tetrads; i++) {
+        if (max_Atoms < io.tetrad[i].num_Atoms) max_Atoms = io.tetrad[i].num_Atoms;
+    }
+    
+    // Allocate memory for arrays
+    num_Pairs  = io.prm.num_Tetrads * (io.prm.num_Tetrads - 1) / 2;
+    pair_Lists = array.allocate_2D_Double_Array(num_Pairs, 2);
+    
+    // The edges of the graph of tasks (every pair has 2 tetrads, the NB forces of
+    // pairs are allocated for the pair lists)
+    if (io.task_Graph) {
+        pair_Displs   = new int [io.prm.num_Tetrads + 1];
+        pair_Sources  = new int [2 * num_Pairs];
+        tile_Displs   = new int [(num_Pairs + NB_TILE - 1) / NB_TILE + 1];
+        tile_Tetrads  = new int [2 * num_Pairs];
+        tile_Pending  = new int [(num_Pairs + NB_TILE - 1) / NB_TILE];
+        tetrad_Displs = new int [io.prm.num_Tetrads + 1];
+        tetrad_Tiles  = new int [2 * num_Pairs];
+        pending       = new int [io.prm.num_Tetrads];
+    }
+    
+    // The NB force arrays of the threads & the NB forces of a pair of tetrads (the
+    // graph of tasks keeps the NB forces of pairs instead)
+    if (!io.task_Graph) {
+        thread_Forces  = new double ** [num_Threads];
+        thread_Scratch = array.allocate_2D_Double_Array(num_Threads, 2 * (3 * max_Atoms + 2));
+        for (i = 0; i < num_Threads; i++) {
+            thread_Forces[i] = array.allocate_2D_Double_Array(io.prm.num_Tetrads, 3 * max_Atoms + 2);
+            for (j = 0; j < io.prm.num_Tetrads * (3 * max_Atoms + 2); j++) { thread_Forces[i][0][j] = 0.0; }
+        }
+    }
+    
+    velocities  = new double [3 * io.crd.total_Atoms];
+    coordinates = new double [3 * io.crd.total_Atoms];
+    
+    // The sources of every coordinate of the DNA in the merge
+    io.generate_Merge_Sources();
+    
+    // Print information of the EDMD simulation
+    cout << endl << "Initialising simulation..." << endl << endl;
+    cout << "The standalone engine, the number of OpenMP threads: " << num_Threads << endl << endl;
+    
+    cout << "Siulation parameters:" << endl;
+    cout << ">>> Total number of iterations  : " << io.nsteps << endl;
+    cout << ">>> Frequency of synchronization: " << io.ntsync << endl;
+    cout << ">>> Frequency of writing energy & temperature, trajectory: " << io.ntwt << endl;
+    cout << ">>> Frequency of updating th coordinates file: " << io.ntpr << endl;
+    if (io.pc_Integration) cout << ">>> Integration of tetrads in the PC subspace" << endl;
+    if (io.task_Graph) cout << ">>> Tetrads integrated as their forces complete (graph of tasks)" << endl;
+    if (io.nb_Interval > 1) cout << ">>> Multiple time stepping, NB forces every " << io.nb_Interval << " steps" << endl;
+    cout << ">>> Seed of the random terms: " << edmd.rng.seed << endl;
+    cout << endl;
+    
+    cout << "DNA Information:" << endl;
+    cout << ">>> The number of DNA Base Pairs  : " << io.crd.num_BP      << endl;
+    cout << ">>> The number of DNA Tetrads     : " << io.prm.num_Tetrads << endl;
+    cout << ">>> Total number of atoms in DNA  : " << io.crd.total_Atoms << endl << endl;
+    
+    cout << "Inputs:" << endl;
+    cout << ">>> The tetrad parameter file path: " << io.prm_File << endl;
+    cout << ">>> The coordinate file path      : " << io.crd_File << endl << endl;
+    
+    cout << "Outputs:" << endl;
+    cout << ">>> Energy & temperature file path: " << io.energy_File  << endl;
+    cout << ">>> The trajectory file path      : " << io.trj_File     << endl;
+    cout << ">>> The new coordinates file path : " << io.new_Crd_File << endl << endl;
+    
+}
+
+
+
+void Standalone::generate_Pair_Lists(void) {
+    
+    num_Pairs = io.generate_Pair_Lists(pair_Lists, &edmd);
+    
+    if (io.task_Graph) build_Task_Graph();
+    
+}
+
+
+
+void Standalone::calculate_Forces(void) {
+    
+    int i, j, i1, i2, width = 3 * max_Atoms + 2;
+    
+    // The NB forces are calculated at the first step after sync & the last step
+    // of every nb_Interval steps, and held in between (multiple time stepping)
+    i = md_Step % io.ntsync;
+    nb_Step = io.is_NB_Step(md_Step);
+    
+    // The energies are only calculated at the last step before they are written
+    energy_Step = (i == io.ntsync - 1 && (md_Step - i) % io.ntwt == 0);
+    
+    // The ED forces of tetrads (none in the PC subspace)
+    if (!io.pc_Integration) {
+        #pragma omp parallel for schedule(dynamic)
+        for (i = 0; i < io.prm.num_Tetrads; i++) {
+            edmd.calculate_ED_Forces(&io.tetrad[i], energy_Step);
+        }
+    }
+    
+    if (!nb_Step) return;
+    
+    // The NB forces of a pair are calculated into the scratch of the thread
+    // (tetrads are shared by threads), and summed up into its NB force array.
+    // The static schedule keeps the sums of a thread count reproducible.
+    #pragma omp parallel private(j, i1, i2)
+    {
+        int tid = 0;
+#ifdef _OPENMP
+        tid = omp_get_thread_num();
+#endif
+        double ** forces = thread_Forces[tid];
+        Tetrad t1, t2;
+    
+        #pragma omp for schedule(static)
+        for (i = 0; i < num_Pairs; i++) {
+    
+            i1 = pair_Lists[i][0];
+            i2 = pair_Lists[i][1];
+            t1 = io.tetrad[i1]; t1.NB_Forces = thread_Scratch[tid];
+            t2 = io.tetrad[i2]; t2.NB_Forces = thread_Scratch[tid] + width;
+            edmd.calculate_NB_Forces(&t1, &t2, energy_Step);
+    
+            // Sum up the NB forces of the specific tetrads
+            for (j = 0; j < 3 * t1.num_Atoms + 2; j++) {
+                forces[i1][j] += t1.NB_Forces[j];
+            }
+            for (j = 0; j < 3 * t2.num_Atoms + 2; j++) {
+                forces[i2][j] += t2.NB_Forces[j];
+            }
+        }
+    }
+    
+    process_NB_Forces();
+    
+}
+
+
+
+void Standalone::process_NB_Forces(void) {
+    
+    int i, j, k;
+    
+    // The rows of tetrads are shared by the threads
+    #pragma omp parallel for private(j, k) schedule(static)
+    for (i = 0; i < io.prm.num_Tetrads; i++) {
+    
+        // Sum up the NB force arrays of the threads into the first one
+        for (k = 1; k < num_Threads; k++) {
+            for (j = 0; j < 3 * io.tetrad[i].num_Atoms + 2; j++) {
+                thread_Forces[0][i][j] += thread_Forces[k][i][j];
+                thread_Forces[k][i][j] = 0.0;
+            }
+        }
+    
+        // Clip & assign the NB forces to tetrads (the array is cleared)
+        edmd.assign_NB_Forces(&io.tetrad[i], thread_Forces[0][i]);
+    }
+    
+}
+
+
+
+void Standalone::update_Velocity(void) {
+    
+    // In the PC subspace the whole step is integrated here (the coordinates are
+    // reconstructed for the next NB step). The tetrads are shared by the threads.
+    int nb_Next = io.is_NB_Step(md_Step + 1);
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < io.prm.num_Tetrads; i++) {
+        if (io.pc_Integration) {
+            edmd.integrate_PC(&io.tetrad[i], i, md_Step, nb_Step, nb_Next);
+            continue;
+        }
+        edmd.calculate_Random_Terms(&io.tetrad[i], i, md_Step);
+        edmd.update_Velocities(&io.tetrad[i]);
+    }
+    md_Step++;
+    
+}
+
+
+
+void Standalone::update_Coordinate(void) {
+    
+    if (io.pc_Integration) return;
+    
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < io.prm.num_Tetrads; i++) {
+        edmd.update_Coordinates(&io.tetrad[i]);
+    }
+    
+}
+
+
+
+void Standalone::merge_Vels_n_Crds(void) {
+    
+    io.merge_Vels_n_Crds(velocities, coordinates, &edmd);
+    
+}
+
+
+
+void Standalone::write_Info(int istep) {
+    
+    io.write_Info(istep, coordinates);
+    
+}
+
+
+
+void Standalone::write_Crds(void) {
+    
+    io.update_Crd_File(velocities, coordinates);
+    
+}
+
+
+
+void Standalone::build_Task_Graph(void) {
+    
+    int i, k, p, t, mark[io.prm.num_Tetrads];
+    
+    // The NB forces of pairs (reallocated when the pair lists grow)
+    if (num_Pairs > pair_Capacity) {
+        if (pair_Capacity > 0) array.deallocate_2D_Double_Array(pair_Forces);
+        pair_Capacity = num_Pairs;
+        pair_Forces   = array.allocate_2D_Double_Array(pair_Capacity, 2 * (3 * max_Atoms + 2));
+    }
+    
+    // The contributions of every tetrad in the pair order (the order a single
+    // thread sums up the NB forces)
+    for (i = 0; i <= io.prm.num_Tetrads; i++) { pair_Displs[i] = 0; }
+    for (p = 0; p < num_Pairs; p++) {
+        pair_Displs[(int) pair_Lists[p][0] + 1]++;
+        pair_Displs[(int) pair_Lists[p][1] + 1]++;
+    }
+    for (i = 0; i < io.prm.num_Tetrads; i++) { pair_Displs[i + 1] += pair_Displs[i]; }
+    for (p = 0; p < num_Pairs; p++) {
+        for (k = 0; k < 2; k++) {
+            i = pair_Lists[p][k];
+            pair_Sources[pair_Displs[i]++] = 2 * p + k;
+        }
+    }
+    for (i = io.prm.num_Tetrads; i > 0; i--) { pair_Displs[i] = pair_Displs[i - 1]; }
+    pair_Displs[0] = 0;
+    
+    // The tetrads of every NB tile (once in a tile)
+    num_Tiles = (num_Pairs + NB_TILE - 1) / NB_TILE;
+    for (i = 0; i < io.prm.num_Tetrads; i++) { mark[i] = -1; }
+    for (tile_Displs[0] = 0, t = 0; t < num_Tiles; t++) {
+        tile_Displs[t + 1] = tile_Displs[t];
+        for (p = t * NB_TILE; p < num_Pairs && p < (t + 1) * NB_TILE; p++) {
+            for (k = 0; k < 2; k++) {
+                i = pair_Lists[p][k];
+                if (mark[i] == t) continue;
+                mark[i] = t;
+                tile_Tetrads[tile_Displs[t + 1]++] = i;
+            }
+        }
+    }
+    
+    // The NB tiles of every tetrad
+    for (i = 0; i <= io.prm.num_Tetrads; i++) { tetrad_Displs[i] = 0; }
+    for (k = 0; k < tile_Displs[num_Tiles]; k++) { tetrad_Displs[tile_Tetrads[k] + 1]++; }
+    for (i = 0; i < io.prm.num_Tetrads; i++) { tetrad_Displs[i + 1] += tetrad_Displs[i]; }
+    for (t = 0; t < num_Tiles; t++) {
+        for (k = tile_Displs[t]; k < tile_Displs[t + 1]; k++) {
+            tetrad_Tiles[tetrad_Displs[tile_Tetrads[k]]++] = t;
+        }
+    }
+    for (i = io.prm.num_Tetrads; i > 0; i--) { tetrad_Displs[i] = tetrad_Displs[i - 1]; }
+    tetrad_Displs[0] = 0;
+    
+}
+
+
+
+void Standalone::step_Task_Graph(void) {
+    
+    int i;
+    
+    // The NB forces are calculated at the first step after sync & the last step
+    // of every nb_Interval steps, and held in between (multiple time stepping)
+    i = md_Step % io.ntsync;
+    nb_Step = io.is_NB_Step(md_Step);
+    
+    // The energies are only calculated at the last step before they are written
+    energy_Step = (i == io.ntsync - 1 && (md_Step - i) % io.ntwt == 0);
+    
+    // The tasks every tetrad & NB tile wait for at this step
+    for (i = 0; i < io.prm.num_Tetrads; i++) {
+        pending[i] = 1 + (nb_Step ? tetrad_Displs[i + 1] - tetrad_Displs[i] : 0);
+    }
+    for (i = 0; i < num_Tiles; i++) { tile_Pending[i] = tile_Displs[i + 1] - tile_Displs[i]; }
+    
+    // A thread spawns the ED tasks, the other tasks are spawned by the tasks they
+    // wait for (the end of the parallel region waits for all of them)
+    #pragma omp parallel
+    {
+        #pragma omp single
+        {
+            for (int k = 0; k < io.prm.num_Tetrads; k++) {
+                #pragma omp task firstprivate(k)
+                ED_Task(k);
+            }
+        }
+    }
+    md_Step++;
+    
+}
+
+
+
+void Standalone::release_Tetrad(int index) {
+    
+    int left;
+    
+    // The flush of the atomic makes the forces of the task visible to the integration
+    #pragma omp atomic capture seq_cst
+    left = --pending[index];
+    
+    if (left == 0) {
+        #pragma omp task firstprivate(index)
+        integrate_Task(index);
+    }
+    
+}
+
+
+
+void Standalone::ED_Task(int index) {
+    
+    int k, t, left;
+    
+    // None in the PC subspace
+    if (!io.pc_Integration) edmd.calculate_ED_Forces(&io.tetrad[index], energy_Step);
+    
+    // The NB tiles read the (shaken) coordinates of their tetrads
+    if (nb_Step) {
+        for (k = tetrad_Displs[index]; k < tetrad_Displs[index + 1]; k++) {
+            t = tetrad_Tiles[k];
+            #pragma omp atomic capture seq_cst
+            left = --tile_Pending[t];
+            
+            if (left == 0) {
+                #pragma omp task firstprivate(t)
+                NB_Task(t);
+            }
+        }
+    }
+    
+    release_Tetrad(index);
+    
+}
+
+
+
+void Standalone::NB_Task(int tile) {
+    
+    int k, p, width = 3 * max_Atoms + 2;
+    Tetrad t1, t2;
+    
+    // The NB forces of a pair are kept apart (summed up by the tetrads)
+    for (p = tile * NB_TILE; p < num_Pairs && p < (tile + 1) * NB_TILE; p++) {
+        t1 = io.tetrad[(int) pair_Lists[p][0]]; t1.NB_Forces = pair_Forces[p];
+        t2 = io.tetrad[(int) pair_Lists[p][1]]; t2.NB_Forces = pair_Forces[p] + width;
+        edmd.calculate_NB_Forces(&t1, &t2, energy_Step);
+    }
+    
+    for (k = tile_Displs[tile]; k < tile_Displs[tile + 1]; k++) {
+        release_Tetrad(tile_Tetrads[k]);
+    }
+    
+}
+
+
+
+void Standalone::integrate_Task(int index) {
+    
+    int j, k, width = 3 * max_Atoms + 2;
+    double force;
+    Tetrad * tetrad = &io.tetrad[index];
+    
+    // Sum up the NB forces of the pairs of the tetrad (in the pair order), clip
+    // them between -1.0 and 1.0 (not the NB & electrostatic energies)
+    if (nb_Step) {
+        for (j = 0; j < 3 * tetrad->num_Atoms + 2; j++) {
+            
+            for (force = 0.0, k = pair_Displs[index]; k < pair_Displs[index + 1]; k++) {
+                force += pair_Forces[pair_Sources[k] / 2][(pair_Sources[k] % 2) * width + j];
+            }
+            
+            if (j < 3 * tetrad->num_Atoms) {
+                if (force < -1.0) force = -1.0;
+                else if (force > 1.0) force = 1.0;
+            }
+            tetrad->NB_Forces[j] = force;
+        }
+    }
+    
+    // The same step as update_Velocity & update_Coordinate
+    if (io.pc_Integration) {
+        edmd.integrate_PC(tetrad, index, md_Step, nb_Step, io.is_NB_Step(md_Step + 1));
+        return;
+    }
+    edmd.calculate_Random_Terms(tetrad, index, md_Step);
+    edmd.update_Velocities(tetrad);
+    edmd.update_Coordinates(tetrad);
+    
+}
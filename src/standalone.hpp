@@ -0,0 +1,283 @@
+/********************************************************************************
+ *                                                                              *
+ *          Porting the Essential Dynamics/Molecular Dynamics method            *
+ *             for large-scale nucleic acid simulations to ARCHER               *
+ *                                                                              *
+ *                               Zhuowei Si                                     *
+ *              EPCC supervisors: Elena Breitmoser, Iain Bethune                *
+ *     External supervisor: Charlie Laughton (The University of Nottingham)     *
+ *                                                                              *
+ *                  MSc in High Performance Computing, EPCC                     *
+ *                       The University of Edinburgh                            *
+ *                                                                              *
+ *******************************************************************************/
+
+/**
+ * File:  standalone.hpp
+ * Brief: The declaration of the Standalone class, the single-process engine
+ *        (threaded with OpenMP) of the simulation without MPI
+ */
+
+#ifndef standalone_hpp
+#define standalone_hpp
+
+#include <iostream>
+#include <cstdlib>
+#include <ctime>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "array.hpp"
+#include "tetrad.hpp"
+#include "edmd.hpp"
+#include "io.hpp"
+
+using namespace std;
+
+// The number of pairs in a tile of NB forces (a task of the graph)
+#define NB_TILE 16
+
+/**
+ * Brief: The Standalone class drives the EDMD class directly over the tetrads
+ *        loaded by the IO class in a single process. The ED forces, the NB forces
+ *        of the pairs & the integration of tetrads are shared by the OpenMP threads,
+ *        with no master/worker messages. The options of the MPI layer in the Config
+ *        file are ignored.
+ */
+class Standalone {
+    
+public:
+    
+    IO io;         // For reading & writing files
+    
+    EDMD edmd;     // For ED/NB forces & velocities & coordinates calculation
+    
+    Array array;   // For allocating & deallocating arrays
+    
+private:
+    
+    int num_Threads;           // The number of OpenMP threads
+    
+    int max_Atoms;             // The maximum number of atoms in a tetrad
+    
+    int num_Pairs;             // The number of tetrad pairs with NB interactions
+    
+    int md_Step;               // The current MD step (the counter of the random terms)
+    
+    int nb_Step;               // Whether the NB forces are calculated at this step
+    
+    int energy_Step;           // Whether the energies are calculated at this step
+    
+    double ** pair_Lists;      // The pair lists of tetrads
+    
+    double *** thread_Forces;  // The NB force arrays of the threads (not with task_Graph)
+    
+    double ** thread_Scratch;  // The NB forces of a pair of tetrads (by thread, not with task_Graph)
+    
+    double * velocities;       // The velocities of the DNA (merged from tetrads)
+    
+    double * coordinates;      // The coordinates of the DNA (merged from tetrads)
+    
+    // The graph of tasks of a step (task_Graph): an NB tile waits for the ED tasks of
+    // its tetrads (the ED forces shake the coordinates), a tetrad waits for its ED task
+    // & the NB tiles of its pairs, and the last task a tile or a tetrad waits for
+    // spawns it
+    int num_Tiles;             // The number of NB tiles of the pair lists
+    
+    int pair_Capacity;         // The number of pairs the NB forces of pairs are allocated for
+    
+    double ** pair_Forces;     // The NB forces of every pair (the first & second tetrad)
+    
+    int * pair_Displs;         // The first pair contribution of every tetrad (in the pair order)
+    
+    int * pair_Sources;        // The contributions (2 * pair + 0 or 1 for the second tetrad)
+    
+    int * tile_Displs;         // The first tetrad of every NB tile
+    
+    int * tile_Tetrads;        // The tetrads of NB tiles (every tetrad once in a tile)
+    
+    int * tetrad_Displs;       // The first NB tile of every tetrad
+    
+    int * tetrad_Tiles;        // The NB tiles of tetrads
+    
+    int * tile_Pending;        // The number of ED tasks an NB tile waits for at this step
+    
+    int * pending;             // The number of tasks a tetrad waits for at this step
+    
+public:
+    
+    /**
+     * Function:  The constructor of Standalone class
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    Standalone(void);
+    
+    /**
+     * Function:  The destructor of Standalone class
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    ~Standalone(void);
+    
+    /**
+     * Function:  Read the Config, parameter & coordinate files, initialise the
+     *            tetrads, the threads and the arrays of the engine
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void initialise(void);
+    
+    /**
+     * Function:  Generate the pair lists of tetrads with NB interactions (the same
+     *            pairs & order as master)
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void generate_Pair_Lists(void);
+    
+    /**
+     * Function:  Calculate the ED forces of all tetrads & the NB forces of all pairs.
+     *            The NB forces are calculated at the first step after sync & the last
+     *            step of every nb_Interval steps, and held in between.
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void calculate_Forces(void);
+    
+    /**
+     * Function:  Update the velocities of all tetrads (with the random terms), or
+     *            integrate them by a step in the PC subspace
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void update_Velocity(void);
+    
+    /**
+     * Function:  Update the coordinates of all tetrads
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void update_Coordinate(void);
+    
+    /**
+     * Function:  Merge the velocities & coordinates of the overlapping tetrads
+     *            (the average of the 4 copies of every base pair)
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void merge_Vels_n_Crds(void);
+    
+    /**
+     * Function:  Write the energies, the temperature & the trajectory
+     *
+     * Parameter: int istep -> The current step
+     *
+     * Return:    None
+     */
+    void write_Info(int istep);
+    
+    /**
+     * Function:  Update the coordinate file
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void write_Crds(void);
+    
+    /**
+     * Function:  Run a step as a graph of tasks (instead of calculate_Forces,
+     *            update_Velocity & update_Coordinate). The ED task of every tetrad
+     *            releases its NB tiles & itself, the task of every NB tile releases
+     *            its tetrads, and a tetrad is integrated (its NB forces summed up in
+     *            the pair order) as soon as all of them are complete.
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void step_Task_Graph(void);
+    
+private:
+    
+    /**
+     * Function:  Sum up the NB force arrays of the threads in the order of threads,
+     *            clip them and assign them to tetrads
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void process_NB_Forces(void);
+    
+    /**
+     * Function:  Build the contributions of tetrads & the tetrads of NB tiles from
+     *            the pair lists (the edges of the graph of tasks)
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void build_Task_Graph(void);
+    
+    /**
+     * Function:  Release a tetrad from a task, and spawn the integration of the
+     *            tetrad after the last task it waits for
+     *
+     * Parameter: int index -> The index of the tetrad
+     *
+     * Return:    None
+     */
+    void release_Tetrad(int index);
+    
+    /**
+     * Function:  The ED task of a tetrad: its ED forces, then the release of its NB
+     *            tiles (spawned after the last ED task they wait for) & of itself
+     *
+     * Parameter: int index -> The index of the tetrad
+     *
+     * Return:    None
+     */
+    void ED_Task(int index);
+    
+    /**
+     * Function:  The task of an NB tile: the NB forces of its pairs into the NB
+     *            forces of pairs, then the release of its tetrads
+     *
+     * Parameter: int tile -> The index of the NB tile
+     *
+     * Return:    None
+     */
+    void NB_Task(int tile);
+    
+    /**
+     * Function:  The task of the integration of a tetrad: sum up & clip its NB forces
+     *            (at the steps of NB forces) and integrate it by a step
+     *
+     * Parameter: int index -> The index of the tetrad
+     *
+     * Return:    None
+     */
+    void integrate_Task(int index);
+    
+};
+
+#endif /* standalone_hpp */
@@ -27,11 +27,126 @@ void Tetrad::allocate_Tetrad_Arrays(void) {
     abq          = new double[3 * num_Atoms];
     eigenvalues  = new double[num_Evecs];
     eigenvectors = Array::allocate_2D_Double_Array(num_Evecs, 3 * num_Atoms);
+    noise_Factors = new double[3 * num_Atoms];
+    inv_Masses   = new double[3 * num_Atoms];
+    ED_Factors   = new double[num_Evecs];
+    pc_Factors   = new double[num_Evecs * (num_Evecs + 7) / 2 + 4];
     velocities   = new double[3 * num_Atoms];
     coordinates  = new double[3 * num_Atoms];
     ED_Forces    = new double[3 * num_Atoms + 1];
     random_Terms = new double[3 * num_Atoms];
     NB_Forces    = new double[3 * num_Atoms + 2];
+    pc_State     = new double[3 * num_Evecs + PC_FRAME + PC_RIGID + PC_HELD];
+    
+}
+
+
+
+void Tetrad::pack_Tetrad_Arrays(Tetrad* tetrad, int num_Tetrads) {
+    
+    int i, j, n;
+    long prm_Size = 0, cst_Size = 0, crd_Size = 0, ED_Size = 0, NB_Size = 0, pc_Size = 0;
+    double * prm, * cst, * vels, * crds, * ED, * NB, * pc, ** evecs;
+    
+    // The sizes of the buffers
+    for (i = 0; i < num_Tetrads; i++) {
+        n = 3 * tetrad[i].num_Atoms;
+        prm_Size += 3 * n + tetrad[i].num_Evecs * (n + 1);
+        cst_Size += 2 * n + tetrad[i].num_Evecs + tetrad[i].num_Evecs * (tetrad[i].num_Evecs + 7) / 2 + 4;
+        crd_Size += n;
+        ED_Size  += 2 * n + 1;
+        NB_Size  += n + 2;
+        pc_Size  += 3 * tetrad[i].num_Evecs + PC_FRAME + PC_RIGID + PC_HELD;
+    }
+    
+    prm  = allocate_Buffer(prm_Size);
+    cst  = allocate_Buffer(cst_Size);
+    vels = allocate_Buffer(crd_Size);
+    crds = allocate_Buffer(crd_Size);
+    ED   = allocate_Buffer(ED_Size);
+    NB   = allocate_Buffer(NB_Size);
+    pc   = allocate_Buffer(pc_Size);
+    
+    // The parameters of a tetrad are in the order of the MPI_Datatype "MPI_Tetrad",
+    // and the random terms follow the ED forces
+    for (i = 0; i < num_Tetrads; i++) {
+        
+        Tetrad * t = &(tetrad[i]);
+        n = 3 * t->num_Atoms;
+        
+        t->avg         = move_Array(t->avg,         n,            &prm);
+        t->masses      = move_Array(t->masses,      n,            &prm);
+        t->abq         = move_Array(t->abq,         n,            &prm);
+        t->eigenvalues = move_Array(t->eigenvalues, t->num_Evecs, &prm);
+        
+        evecs = new double * [t->num_Evecs];
+        for (j = 0; j < t->num_Evecs; j++) {
+            evecs[j] = prm; prm += n;
+            memcpy(evecs[j], t->eigenvectors[j], n * sizeof(double));
+        }
+        Array::deallocate_2D_Double_Array(t->eigenvectors);
+        t->eigenvectors = evecs;
+        
+        t->noise_Factors = move_Array(t->noise_Factors, n,            &cst);
+        t->inv_Masses    = move_Array(t->inv_Masses,    n,            &cst);
+        t->ED_Factors    = move_Array(t->ED_Factors,    t->num_Evecs, &cst);
+        t->pc_Factors    = move_Array(t->pc_Factors,    t->num_Evecs * (t->num_Evecs + 7) / 2 + 4, &cst);
+        
+        t->velocities   = move_Array(t->velocities,   n,     &vels);
+        t->coordinates  = move_Array(t->coordinates,  n,     &crds);
+        t->ED_Forces    = move_Array(t->ED_Forces,    n + 1, &ED);
+        t->random_Terms = move_Array(t->random_Terms, n,     &ED);
+        t->NB_Forces    = move_Array(t->NB_Forces,    n + 2, &NB);
+        t->pc_State     = move_Array(t->pc_State, 3 * t->num_Evecs + PC_FRAME + PC_RIGID + PC_HELD, &pc);
+    }
+    
+}
+
+
+
+void Tetrad::deallocate_Packed_Arrays(Tetrad* tetrad, int num_Tetrads) {
+    
+    if (num_Tetrads == 0) return;
+    
+    // The first tetrad is at the start of the buffers
+    free(tetrad[0].avg);
+    free(tetrad[0].noise_Factors);
+    free(tetrad[0].velocities);
+    free(tetrad[0].coordinates);
+    free(tetrad[0].ED_Forces);
+    free(tetrad[0].NB_Forces);
+    free(tetrad[0].pc_State);
+    
+    for (int i = 0; i < num_Tetrads; i++) { delete [] tetrad[i].eigenvectors; }
+    
+}
+
+
+
+double* Tetrad::allocate_Buffer(long size) {
+    
+    void * buffer;
+    
+    if (posix_memalign(&buffer, BUFFER_ALIGN, (size > 0 ? size : 1) * sizeof(double)) != 0) {
+        cout << ">>> ERROR: Can not allocate the buffers of tetrads!" << endl;
+        exit(1);
+    }
+    
+    return (double *) buffer;
+    
+}
+
+
+
+double* Tetrad::move_Array(double* array, int count, double** cursor) {
+    
+    double * position = *cursor;
+    
+    memcpy(position, array, count * sizeof(double));
+    delete [] array;
+    *cursor += count;
+    
+    return position;
     
 }
 
@@ -44,11 +159,16 @@ void Tetrad::deallocate_Tetrad_Arrays(void) {
     delete [] abq;
     delete [] eigenvalues;
     Array::deallocate_2D_Double_Array(eigenvectors);
+    delete [] noise_Factors;
+    delete [] inv_Masses;
+    delete [] ED_Factors;
+    delete [] pc_Factors;
     delete [] velocities;
     delete [] coordinates;
     delete [] ED_Forces;
     delete [] random_Terms;
     delete [] NB_Forces;
+    delete [] pc_State;
     
 }
 
@@ -21,8 +21,22 @@
 #define tetrad_hpp
 
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 #include "array.hpp"
 
+// The alignment (bytes) of the contiguous buffers of the arrays of all tetrads
+#define BUFFER_ALIGN 64
+
+// The frame (rotation matrix 9 & offset vector 3) and the velocities of the frame
+// (linear 3 & angular 3) in the state of a tetrad in the PC subspace
+#define PC_FRAME 12
+#define PC_RIGID 6
+
+// The NB force (3) & torque (3) of the frame and the inertia of the frame (9) held
+// from the last NB step, after the held NB forces of the amplitudes (PC subspace)
+#define PC_HELD 15
+
 using namespace std;
 
 /**
@@ -46,6 +60,17 @@ public:
     double * eigenvalues;  // The eigenvalues calculated from PCA
     
     double** eigenvectors; // The eigenvectors obtained from PCA
+    
+    double * noise_Factors; // The noise factors of the random terms, sqrt(2*gamma*kT*m/dt)
+    
+    double * inv_Masses;   // The inverse masses of every atom in tetrad
+    
+    double * ED_Factors;   // The ED force factors of the eigenvectors, kT/eigenvalue
+    
+    double * pc_Factors;   // The constants of the PC subspace: the Cholesky factor of the
+                           // covariance of the random terms of the amplitudes (packed lower
+                           // triangle), the centre of mass of the eigenvectors & of the
+                           // average structure, and the mass of the tetrad
 
     double * ED_Forces;    // The ED forces (Laset element: ED energy)
     
@@ -58,6 +83,10 @@ public:
     double * velocities;   // The velocities of tetrad
     
     double * coordinates;  // The coordinates of tetrad
+    
+    double * pc_State;     // The state in the PC subspace: the PC amplitudes, the frame,
+                           // the velocities of the amplitudes & of the frame, and the
+                           // NB forces held from the last NB step (see PC_HELD)
    
 public:
     
@@ -78,6 +107,53 @@ public:
      * Return:    None
      */
     void deallocate_Tetrad_Arrays(void);
+    
+    /**
+     * Function:  Move the arrays of all tetrads into contiguous (aligned) buffers,
+     *            one per kind of data: the parameters, the integration constants,
+     *            the velocities, the coordinates, the ED forces & random terms, the
+     *            NB forces, and the states in the PC subspace. The arrays of tetrads
+     *            point into the buffers at their offsets, so the data of consecutive
+     *            tetrads are passed in contiguous blocks.
+     *
+     * Parameter: Tetrad* tetrad   -> The tetrad array (with allocated arrays)
+     *            int num_Tetrads  -> The number of tetrads
+     *
+     * Return:    None
+     */
+    static void pack_Tetrad_Arrays(Tetrad* tetrad, int num_Tetrads);
+    
+    /**
+     * Function:  Deallocate the buffers of the packed arrays of all tetrads
+     *
+     * Parameter: Tetrad* tetrad   -> The tetrad array (with packed arrays)
+     *            int num_Tetrads  -> The number of tetrads
+     *
+     * Return:    None
+     */
+    static void deallocate_Packed_Arrays(Tetrad* tetrad, int num_Tetrads);
+    
+private:
+    
+    /**
+     * Function:  Allocate an aligned buffer of doubles
+     *
+     * Parameter: long size -> The number of doubles
+     *
+     * Return:    The buffer
+     */
+    static double* allocate_Buffer(long size);
+    
+    /**
+     * Function:  Copy an array into a buffer (at the cursor) & deallocate it
+     *
+     * Parameter: double* array   -> The array to be moved
+     *            int count       -> The number of elements
+     *            double** cursor -> The position in the buffer (advanced by count)
+     *
+     * Return:    The new position of the array in the buffer
+     */
+    static double* move_Array(double* array, int count, double** cursor);
 
 };
 
@@ -26,6 +26,16 @@ Worker::Worker(void) {
     MPI_Comm_rank(comm, &rank);
     MPI_Comm_size(comm, &size);
     
+    // Without the ED & NB groups, the NB group is all processes
+    ed_Group    = 0;
+    split_Group = -1;
+    ED_Comm     = MPI_COMM_NULL;
+    NB_Comm     = comm;
+    MPI_ED_Crds = MPI_DATATYPE_NULL;
+    NB_Request  = MPI_REQUEST_NULL;
+    crd_Headers = 0;
+    ED_Time     = 0.0;
+    
 }
 
 
@@ -36,14 +46,71 @@ Worker::~Worker(void) {
     array.deallocate_2D_Double_Array(pair_Lists);
     array.deallocate_2D_Int_Array(ED_Index);
     array.deallocate_2D_Int_Array(NB_Index);
-    array.deallocate_2D_Double_Array(NB_Forces);
+    array.deallocate_2D_Int_Array(NB_Chunks);
+    if (!shm_Node) array.deallocate_2D_Double_Array(NB_Forces);
+    delete [] touched;
+    delete [] NB_Rows;
+    for (int i = 0; i < num_Threads; i++) { delete [] thread_Forces[i]; }
+    delete [] thread_Forces;
+    array.deallocate_2D_Int_Array(thread_Slots);
+    delete [] thread_Count;
+    delete [] thread_Capacity;
+    array.deallocate_2D_Double_Array(thread_Scratch);
 
     // Free the MPI Data type
     for (int i = 0; i < num_Tetrads; i++) {
-        tetrad[i].deallocate_Tetrad_Arrays();
         mpi.free_MPI_ED_Forces(&(MPI_ED_Forces[i]));
     }
+    Tetrad::deallocate_Packed_Arrays(tetrad, num_Tetrads);
     mpi.free_MPI_Crds(&MPI_Crds);
+    if (header_Crds) mpi.free_MPI_Crds(&MPI_Header);
+    if (pc_Integration) mpi.free_MPI_Crds(&MPI_PC_Crds);
+    
+    // Free the RMA window of the NB chunk counter
+    if (nb_Schedule != 0) MPI_Win_free(&NB_Win);
+    
+    // Free the communicators & MPI_Datatype of the ED & NB groups
+    if (MPI_ED_Crds != MPI_DATATYPE_NULL) mpi.free_MPI_Crds(&MPI_ED_Crds);
+    if (ED_Comm != MPI_COMM_NULL) MPI_Comm_free(&ED_Comm);
+    if (NB_Comm != MPI_COMM_NULL && NB_Comm != comm) MPI_Comm_free(&NB_Comm);
+    
+    // Free the communicator & MPI_Datatype of the distributed integration
+    if (integration) {
+        for (int i = 0; i < num_Tetrads; i++) {
+            mpi.free_MPI_State(&(MPI_State[i]));
+        }
+        delete [] MPI_State;
+        mpi.free_MPI_State(&MPI_Vels_n_Crds);
+        MPI_Comm_free(&MD_Comm);
+    }
+    delete [] crd_Displs;
+    if (crd_Precision) {
+        delete [] crd_Floats;
+        delete [] crd_Ref;
+    }
+    
+    // Free the shared memory & the communicators of nodes (the NB force array
+    // is in the shared memory)
+    if (shm_Node) {
+        MPI_Win_unlock_all(crd_Win);
+        MPI_Win_unlock_all(force_Win);
+        MPI_Win_free(&crd_Win);
+        MPI_Win_free(&force_Win);
+        MPI_Comm_free(&node_Comm);
+        if (leader_Comm != MPI_COMM_NULL) MPI_Comm_free(&leader_Comm);
+        delete [] NB_Forces;
+        delete [] node_Forces;
+        delete [] NB_Tetrad;
+    }
+    
+    // Free the MPI_Datatype of the halo
+    if (MPI_Halo != MPI_DATATYPE_NULL) mpi.free_MPI_Crds(&MPI_Halo);
+    for (int i = 0; i < size; i++) {
+        if (halo_Send[i] != MPI_DATATYPE_NULL) mpi.free_MPI_Crds(&(halo_Send[i]));
+        if (halo_Recv[i] != MPI_DATATYPE_NULL) mpi.free_MPI_Crds(&(halo_Recv[i]));
+    }
+    delete [] halo_Send;
+    delete [] halo_Recv;
     
 }
 
@@ -51,15 +118,33 @@ Worker::~Worker(void) {
 
 void Worker::recv_Parameters(void) {
     
-    double edmd_Para[11];
+    double edmd_Para[NUM_PARA];
     
     // Receive edmd simulation parameters
-    MPI_Bcast(edmd_Para, 11, MPI_DOUBLE, 0, comm);
+    MPI_Bcast(edmd_Para, NUM_PARA, MPI_DOUBLE, 0, comm);
     edmd.initialise(edmd_Para[0], edmd_Para[1], edmd_Para[2], edmd_Para[3],
                     edmd_Para[4], edmd_Para[5], edmd_Para[6], edmd_Para[7]);
     num_Tetrads = (int) edmd_Para[8];
     num_Pairs   = (int) edmd_Para[9];
     max_Atoms   = (int) edmd_Para[10];
+    nb_Schedule = (int) edmd_Para[11];
+    nb_Chunk    = (int) edmd_Para[12];
+    load_Balance = (int) edmd_Para[13];
+    nb_Partition = (int) edmd_Para[14];
+    ed_Workers   = (int) edmd_Para[15];
+    nb_Reduce    = (int) edmd_Para[16];
+    nb_Overlap   = (int) edmd_Para[17];
+    integration  = (int) edmd_Para[18];
+    crd_Exchange = (int) edmd_Para[19];
+    shm_Node     = (int) edmd_Para[20];
+    omp_Threads  = (int) edmd_Para[21];
+    crd_Precision = (int) edmd_Para[22];
+    edmd.rng.seed = (unsigned int) edmd_Para[23];
+    md_Step       = 0;
+    nb_Interval   = (int) edmd_Para[24];
+    nb_Step       = 1;
+    energy_Step   = 1;
+    pc_Integration = (int) edmd_Para[25];
     int * tetrad_Para = new int[2 * num_Tetrads];
     
     // Receive the tetrad parameters & initialise the tetrad array
@@ -72,6 +157,9 @@ void Worker::recv_Parameters(void) {
         tetrad[i].allocate_Tetrad_Arrays();
     }
     
+    // Move the arrays of tetrads into contiguous buffers (as on master)
+    Tetrad::pack_Tetrad_Arrays(tetrad, num_Tetrads);
+    
     // Create new MPI_Datatype for ED/NB force calcation.
     MPI_ED_Forces = new MPI_Datatype [num_Tetrads]; // For every tetrad
     for (int i = 0; i < num_Tetrads; i++) {
@@ -82,9 +170,86 @@ void Worker::recv_Parameters(void) {
     // The parameters for pair lists & workeload
     num_Pairs  = num_Tetrads * (num_Tetrads - 1) / 2;
     pair_Lists = array.allocate_2D_Double_Array(num_Pairs, 2);
-    ED_Index   = array.allocate_2D_Int_Array(size - 1, 2);
-    NB_Index   = array.allocate_2D_Int_Array(size - 1, 2);
-    NB_Forces  = array.allocate_2D_Double_Array(num_Tetrads, 3 * max_Atoms + 2);
+    ED_Index   = array.allocate_2D_Int_Array(size, 2);
+    NB_Index   = array.allocate_2D_Int_Array(size, 2);
+    NB_Chunks  = array.allocate_2D_Int_Array(num_Pairs, 2);
+    num_Chunks = 0;
+    
+    // The timings of workers are piggybacked on the NB force reduction in extra rows
+    num_Rows   = num_Tetrads;
+    if (load_Balance) num_Rows += (2 * size + 3 * max_Atoms + 1) / (3 * max_Atoms + 2);
+    NB_Forces  = array.allocate_2D_Double_Array(num_Rows, 3 * max_Atoms + 2);
+    NB_Rows    = new double [num_Rows * (3 * max_Atoms + 3)];
+    touched    = new int [num_Rows];
+    for (int i = 0; i < num_Rows; i++) { touched[i] = 0; }
+    
+    // The window of the NB chunk counter (workers expose no memory)
+    if (nb_Schedule != 0) {
+        MPI_Win_create(NULL, 0, sizeof(int), MPI_INFO_NULL, comm, &NB_Win);
+    }
+    
+    // The displacements of tetrads in the (contiguous) coordinate arrays
+    crd_Displs = new int [num_Tetrads + 1];
+    crd_Displs[0] = 0;
+    for (int i = 0; i < num_Tetrads; i++) {
+        crd_Displs[i + 1] = crd_Displs[i] + 3 * tetrad[i].num_Atoms;
+    }
+    
+    // The buffers of the coordinates received in reduced precision
+    if (crd_Precision) {
+        crd_Floats = new float  [crd_Displs[num_Tetrads]];
+        crd_Ref    = new double [crd_Displs[num_Tetrads]];
+    }
+    
+    // The MPI_Datatype of the halo (of this worker & of other workers)
+    MPI_Halo  = MPI_DATATYPE_NULL;
+    halo_Send = new MPI_Datatype [size];
+    halo_Recv = new MPI_Datatype [size];
+    for (int i = 0; i < size; i++) { halo_Send[i] = halo_Recv[i] = MPI_DATATYPE_NULL; }
+    
+    // The communicator & MPI_Datatype of the distributed integration
+    if (integration) {
+        MPI_Comm_split(comm, 0, rank, &MD_Comm);
+        MPI_State = new MPI_Datatype [num_Tetrads];
+        for (int i = 0; i < num_Tetrads; i++) {
+            mpi.create_MPI_State(&(MPI_State[i]), &(tetrad[i]));
+        }
+        mpi.create_MPI_Vels_n_Crds(&MPI_Vels_n_Crds, num_Tetrads, tetrad);
+    }
+    
+    // The header of commands carries the coordinates (or the velocities &
+    // coordinates, or the PC amplitudes & frames) when they are broadcast to all workers
+    header_Crds = integration || (!shm_Node && !crd_Exchange && ed_Workers == 0 && !crd_Precision);
+    if (pc_Integration) {
+        mpi.create_MPI_PC_Crds(&MPI_PC_Crds, num_Tetrads, tetrad);
+        mpi.create_MPI_Header(&MPI_Header, header, MPI_PC_Crds, tetrad);
+    } else if (header_Crds) {
+        mpi.create_MPI_Header(&MPI_Header, header, integration ? MPI_Vels_n_Crds : MPI_Crds, tetrad);
+    }
+    
+    // The OpenMP threads, with their own rows of NB forces (allocated as they
+    // touch tetrads) & the NB forces of a pair of tetrads (thread 0 sums up into
+    // the NB force array of this worker)
+    num_Threads = 1;
+#ifdef _OPENMP
+    if (omp_Threads > 0) omp_set_num_threads(omp_Threads);
+    num_Threads = omp_get_max_threads();
+#endif
+    thread_Forces   = new double * [num_Threads];
+    thread_Slots    = array.allocate_2D_Int_Array(num_Threads, num_Tetrads);
+    thread_Count    = new int [num_Threads];
+    thread_Capacity = new int [num_Threads];
+    thread_Scratch  = array.allocate_2D_Double_Array(num_Threads, 2 * (3 * max_Atoms + 2));
+    for (int i = 0; i < num_Threads; i++) {
+        thread_Forces[i] = NULL;
+        thread_Count[i]  = thread_Capacity[i] = 0;
+        for (int j = 0; j < num_Tetrads; j++) { thread_Slots[i][j] = -1; }
+    }
+    
+    // The shared memory of nodes (otherwise the NB forces are calculated with the
+    // coordinates of the tetrads of this worker)
+    NB_Tetrad = tetrad;
+    if (shm_Node) setup_Shared();
     
     delete [] tetrad_Para;
     
@@ -100,6 +265,9 @@ void Worker::recv_Tetrads(void) {
     
     MPI_Bcast(tetrad, 1, MPI_Tetrad, 0, comm);
     
+    // The integration constants of tetrads (from the parameters received)
+    edmd.initialise_Constants(tetrad, num_Tetrads);
+    
     mpi.free_MPI_Tetrad(&MPI_Tetrad);
     
 }
@@ -108,81 +276,669 @@ void Worker::recv_Tetrads(void) {
 
 void Worker::recv_Messages(void) {
     
-    int signal = 1, flag;
     MPI_Status recv_Status;
     
-    while (signal != TAG_END) {
+    while (1) {
+        
+        // Wait for the next command of master
+        recv_Header();
         
-        // Test if there is any message arrived
-        MPI_Iprobe(0, MPI_ANY_TAG, comm, &flag, &recv_Status);
+        if (header[0] == TAG_END) break;
         
-        if (flag && recv_Status.MPI_TAG >= TAG_PAIRS && recv_Status.MPI_TAG <= TAG_PAIRS + 2) {
+        if (header[0] == TAG_PAIRS) {
+            crd_Headers = header[1];
             MPI_Recv(&(pair_Lists[0][0]), 2 * num_Pairs, MPI_DOUBLE, 0, TAG_PAIRS, comm, &recv_Status);
-            MPI_Recv(&(NB_Index[0][0]), 2 * (size - 1), MPI_INT, 0, TAG_PAIRS + 1, comm, &recv_Status);
-            MPI_Recv(&(ED_Index[0][0]), 2 * (size - 1), MPI_INT, 0, TAG_PAIRS + 2, comm, &recv_Status);
+            MPI_Recv(&(NB_Index[0][0]), 2 * size, MPI_INT, 0, TAG_PAIRS + 1, comm, &recv_Status);
+            MPI_Recv(&(ED_Index[0][0]), 2 * size, MPI_INT, 0, TAG_PAIRS + 2, comm, &recv_Status);
+            
+            // Join the ED or the NB group
+            if (ed_Workers != 0) setup_Groups();
+            
+            // The coordinates of the own tetrads in the ED group (or with the reduced
+            // precision, in double as the ED forces send them back to master)
+            if (MPI_ED_Crds != MPI_DATATYPE_NULL) mpi.free_MPI_Crds(&MPI_ED_Crds);
+            if ((rank <= ed_Group || crd_Precision) && ED_Index[rank][1] > 0) {
+                mpi.create_MPI_Crds(&MPI_ED_Crds, ED_Index[rank][1], &(tetrad[ED_Index[rank][0]]));
+            }
+            
+            // The halo of the coordinates of this worker
+            if (crd_Exchange) setup_Halo();
+            
+            // Receive the chunks of the pair lists for the dynamic NB schedules
+            if (nb_Schedule != 0) {
+                MPI_Bcast(&num_Chunks, 1, MPI_INT, 0, comm);
+                MPI_Bcast(&(NB_Chunks[0][0]), 2 * num_Chunks, MPI_INT, 0, comm);
+            }
         }
         
-        else if (flag && recv_Status.MPI_TAG == TAG_FORCE) {
-            // Receive the force calculation single
-            MPI_Recv(&flag, 1, MPI_INT, 0, TAG_FORCE, comm, &recv_Status);
+        else if (header[0] == TAG_FORCE) {
+            // Integrate the tetrads of this worker (the argument is the number
+            // of steps, the velocities & coordinates are in the header)
+            if (integration) {
+                integrate_Tetrads(header[1]);
+                continue;
+            }
             
-            // Receive the coordinates of all tetrads
-            MPI_Bcast(tetrad, 1, MPI_Crds, 0, comm);
+            // Receive the coordinates of all tetrads (unless they are in the
+            // header, or only the own tetrads in the ED group, or only the halo,
+            // or the shared memory of the node). They are in reduced precision
+            // except the first step after sync (a flag of the argument), and the
+            // own tetrads are then received in double over them (the ED forces
+            // shake them & send them back to master).
+            nb_Step = header[1] & ARG_NB_FORCES;
+            energy_Step = header[1] & ARG_ENERGIES;
+            if (shm_Node) {
+                share_Crds();
+            } else if (crd_Exchange) {
+                if (MPI_Halo != MPI_DATATYPE_NULL) {
+                    MPI_Recv(tetrad, 1, MPI_Halo, 0, TAG_CRDS, comm, &recv_Status);
+                }
+            } else if (rank <= ed_Group) {
+                if (ED_Index[rank][1] > 0) {
+                    MPI_Recv(&(tetrad[ED_Index[rank][0]]), 1, MPI_ED_Crds, 0, TAG_CRDS, comm, &recv_Status);
+                }
+            } else if (crd_Precision && !(header[1] & ARG_FULL_FRAME)) {
+                MPI_Bcast(crd_Floats, crd_Displs[num_Tetrads], MPI_FLOAT, 0, NB_Comm);
+                decode_Crds();
+                if (MPI_ED_Crds != MPI_DATATYPE_NULL) {
+                    MPI_Recv(&(tetrad[ED_Index[rank][0]]), 1, MPI_ED_Crds, 0, TAG_CRDS, comm, &recv_Status);
+                }
+            } else if (!header_Crds) {
+                MPI_Bcast(tetrad, 1, MPI_Crds, 0, NB_Comm);
+                if (crd_Precision == 2) {
+                    memcpy(crd_Ref, tetrad[0].coordinates, crd_Displs[num_Tetrads] * sizeof(double));
+                }
+            }
+            
+            // Reconstruct the coordinates of all tetrads from their PC states (in
+            // the header), only needed by the NB forces
+            if (pc_Integration && nb_Step) {
+                #pragma omp parallel for schedule(static)
+                for (int i = 0; i < num_Tetrads; i++) { edmd.reconstruct_Crds(&(tetrad[i])); }
+            }
             
             // Start the ED/NB force calculation
             force_Calculation();
         }
         
-        else if (flag && recv_Status.MPI_TAG == TAG_END){
-            MPI_Recv(&signal, 1, MPI_INT, 0, TAG_END, comm, &recv_Status);
-        }
+    }
+    
+}
+
 
+
+void Worker::decode_Crds(void) {
+    
+    double * crds = tetrad[0].coordinates; // All tetrads (contiguous)
+    
+    for (int i = 0; i < crd_Displs[num_Tetrads]; i++) {
+        crds[i] = (double) crd_Floats[i];
+        if (crd_Precision == 2) crds[i] += crd_Ref[i];
     }
     
 }
 
 
 
+void Worker::recv_Header(void) {
+    
+    // Only the force commands of the sync carry the coordinates (the next command
+    // after them is TAG_PAIRS or TAG_END, the bare header)
+    if (header_Crds && crd_Headers > 0) {
+        MPI_Bcast(tetrad, 1, MPI_Header, 0, comm);
+        crd_Headers--;
+    } else {
+        MPI_Bcast(header, 2, MPI_INT, 0, comm);
+    }
+    
+}
+
+
+
+void Worker::setup_Groups(void) {
+    
+    // Receive the number of workers in the ED group
+    MPI_Bcast(&ed_Group, 1, MPI_INT, 0, comm);
+    
+    // Split the workers into the ED & NB groups, master is rank 0 of both (only
+    // when the groups change, the old communicators are freed)
+    if (ed_Group != split_Group) {
+        if (ED_Comm != MPI_COMM_NULL) MPI_Comm_free(&ED_Comm);
+        if (NB_Comm != MPI_COMM_NULL && NB_Comm != comm) MPI_Comm_free(&NB_Comm);
+        MPI_Comm_split(comm, (rank <= ed_Group) ? 0 : MPI_UNDEFINED, rank, &ED_Comm);
+        MPI_Comm_split(comm, (rank >  ed_Group) ? 0 : MPI_UNDEFINED, rank, &NB_Comm);
+        split_Group = ed_Group;
+    }
+    
+}
+
+
 
 void Worker::force_Calculation() {
     
-    int i, j, i1, i2;
-    int workload = ED_Index[rank - 1][1];
+    int i, workload = ED_Index[rank][1];
+    double NB_Time;
     MPI_Request send_Request[workload];
     MPI_Status send_Status[workload];
     
-    // Calculate the ED forces and the random terms
-    for (i = ED_Index[rank - 1][0]; i < ED_Index[rank - 1][0] + ED_Index[rank - 1][1]; i++) {
+    // Calculate the ED forces (after the NB forces when they overlap the NB
+    // reduction)
+    if (!nb_Overlap || rank <= ed_Group) ED_Time = calculate_ED_Share(send_Request);
+    
+    // The ED group only reduce their timings to master (at the steps of the NB
+    // forces, as the NB group)
+    if (rank <= ed_Group) {
+        if (load_Balance && nb_Step) {
+            double timings[2 * size];
+            for (i = 0; i < 2 * size; i++) { timings[i] = 0.0; }
+            timings[2 * rank] = ED_Time;
+            MPI_Reduce(timings, timings, 2 * size, MPI_DOUBLE, MPI_SUM, 0, ED_Comm);
+        }
+        MPI_Waitall(workload, send_Request, send_Status);
+        return;
+    }
+    
+    // Only the ED forces at the steps without NB forces (held by master)
+    if (!nb_Step) {
+        if (nb_Overlap) ED_Time = calculate_ED_Share(send_Request);
+        MPI_Waitall(workload, send_Request, send_Status);
+        return;
+    }
+    
+    // Calculate the NB forces
+    empty_NB_Forces();
+    NB_Time = calculate_NB_Share();
+    
+    // Piggyback the timings on the reduction, in the slots of this worker (the
+    // ED time is the one of the last step when the ED forces come later)
+    if (load_Balance) {
+        double * timings = &(NB_Forces[num_Tetrads][0]);
+        timings[2 * rank] = ED_Time; timings[2*rank+1] = NB_Time;
+    }
+    
+    // Start to reduce & sum up the NB forces to the master (only the touched rows
+    // with the sparse reduction)
+    if (shm_Node) {
+        reduce_Node_Forces();
+    } else if (nb_Reduce != 0) {
+        reduce_NB_Rows();
+    } else {
+        MPI_Ireduce(&(NB_Forces[0][0]), &(NB_Forces[0][0]), num_Rows * (3 * max_Atoms + 2), MPI_DOUBLE, MPI_SUM, 0, NB_Comm, &NB_Request);
+    }
+    
+    // The ED forces overlap the NB reduction
+    if (nb_Overlap) ED_Time = calculate_ED_Share(send_Request);
+    
+    // Wait the NB reduction & all ED forces to be received
+    MPI_Wait(&NB_Request, MPI_STATUS_IGNORE);
+    MPI_Waitall(workload, send_Request, send_Status);
+    
+}
+
+
+
+double Worker::calculate_ED_Share(MPI_Request* send_Request) {
+    
+    int i, start = ED_Index[rank][0], count = ED_Index[rank][1];
+    double start_Time = MPI_Wtime();
+    
+    // The tetrads are shared by the threads
+    #pragma omp parallel for schedule(dynamic)
+    for (i = start; i < start + count; i++) {
+        edmd.calculate_ED_Forces(&(tetrad[i]), energy_Step);
+    }
+    
+    // Only the master thread communicates (MPI_THREAD_FUNNELED)
+    for (i = start; i < start + count; i++) {
+        MPI_Isend(&(tetrad[i]), 1, MPI_ED_Forces[i], 0, TAG_ED + i, comm, &(send_Request[i - start]));
+    }
+    
+    return MPI_Wtime() - start_Time;
+    
+}
+
+
+
+double Worker::calculate_NB_Share(void) {
+    
+    int chunk, one = 1;
+    double start_Time = MPI_Wtime();
+    
+    if (nb_Schedule == 0) {
+        calculate_NB_Pairs(NB_Index[rank][0], NB_Index[rank][1]);
+    } else {
+        // Take chunks of the pair lists from the counter on master (atomically)
+        // until all chunks are taken
+        MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, NB_Win);
+        while (1) {
+            MPI_Fetch_and_op(&one, &chunk, MPI_INT, 0, 0, MPI_SUM, NB_Win);
+            MPI_Win_flush(0, NB_Win);
+            if (chunk >= num_Chunks) break;
+            calculate_NB_Pairs(NB_Chunks[chunk][0], NB_Chunks[chunk][1]);
+        }
+        MPI_Win_unlock(0, NB_Win);
+    }
+    sum_Thread_Forces();
+    
+    return MPI_Wtime() - start_Time;
+    
+}
+
+
+
+void Worker::setup_Shared(void) {
+    
+    int i, j, disp_Unit, width = 3 * max_Atoms + 2;
+    MPI_Aint bytes;
+    double * base;
+    
+    // The processes of a node, and the leaders (node rank 0) of nodes
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_Comm);
+    MPI_Comm_rank(node_Comm, &node_Rank);
+    MPI_Comm_size(node_Comm, &node_Size);
+    MPI_Comm_split(comm, (node_Rank == 0) ? 0 : MPI_UNDEFINED, rank, &leader_Comm);
+    
+    // The coordinates of all tetrads, one array per node (on the leader)
+    bytes = (node_Rank == 0) ? crd_Displs[num_Tetrads] * sizeof(double) : 0;
+    MPI_Win_allocate_shared(bytes, sizeof(double), MPI_INFO_NULL, node_Comm, &shm_Crds, &crd_Win);
+    MPI_Win_shared_query(crd_Win, 0, &bytes, &disp_Unit, &shm_Crds);
+    
+    // The NB force array of every process in the shared memory
+    bytes = num_Rows * width * sizeof(double);
+    MPI_Win_allocate_shared(bytes, sizeof(double), MPI_INFO_NULL, node_Comm, &base, &force_Win);
+    array.deallocate_2D_Double_Array(NB_Forces);
+    NB_Forces = new double * [num_Rows];
+    for (i = 0; i < num_Rows; i++) {
+        NB_Forces[i] = base + i * width;
+        for (j = 0; j < width; j++) { NB_Forces[i][j] = 0.0; }
+    }
+    node_Forces = new double * [node_Size];
+    for (i = 0; i < node_Size; i++) {
+        MPI_Win_shared_query(force_Win, i, &bytes, &disp_Unit, &(node_Forces[i]));
+    }
+    
+    // The NB forces are calculated with the shared coordinates (the other arrays
+    // are the ones of the tetrads). The ED forces still use the coordinates of
+    // the tetrads as they are modified (shaken).
+    NB_Tetrad = new Tetrad [num_Tetrads];
+    for (i = 0; i < num_Tetrads; i++) {
+        NB_Tetrad[i] = tetrad[i];
+        NB_Tetrad[i].coordinates = shm_Crds + crd_Displs[i];
+    }
+    
+    // The windows are accessed by load/store in a passive epoch
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, crd_Win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, force_Win);
+    
+}
+
+
+
+void Worker::sync_Node(MPI_Win win) {
+    
+    MPI_Win_sync(win);
+    MPI_Barrier(node_Comm);
+    MPI_Win_sync(win);
+    
+}
+
+
+
+void Worker::share_Crds(void) {
+    
+    int i, j;
+    
+    // The leaders receive the coordinates into the shared memory of their nodes
+    if (node_Rank == 0) {
+        MPI_Bcast(shm_Crds, crd_Displs[num_Tetrads], MPI_DOUBLE, 0, leader_Comm);
+    }
+    sync_Node(crd_Win);
+    
+    // Copy the coordinates of the tetrads of the ED forces (contiguous)
+    i = ED_Index[rank][0];
+    j = crd_Displs[i + ED_Index[rank][1]] - crd_Displs[i];
+    memcpy(tetrad[i].coordinates, shm_Crds + crd_Displs[i], j * sizeof(double));
+    
+}
+
+
+
+void Worker::reduce_Node_Forces(void) {
+    
+    int i, k, width = 3 * max_Atoms + 2;
+    int first = node_Rank * num_Rows / node_Size, last = (node_Rank + 1) * num_Rows / node_Size;
+    
+    // Every process of the node sums up a slice of rows of the NB force arrays
+    // of the node into the array of the leader
+    sync_Node(force_Win);
+    for (k = 1; k < node_Size; k++) {
+        for (i = first * width; i < last * width; i++) { node_Forces[0][i] += node_Forces[k][i]; }
+    }
+    sync_Node(force_Win);
+    
+    // A single reduction of every node to master
+    if (node_Rank == 0) {
+        MPI_Reduce(&(NB_Forces[0][0]), &(NB_Forces[0][0]), num_Rows * width, MPI_DOUBLE, MPI_SUM, 0, leader_Comm);
+    }
+    
+}
+
+
+
+void Worker::setup_Halo(void) {
+    
+    int i, j, r, count, owner;
+    int * list = new int [num_Tetrads], * mark = new int [num_Tetrads];
+    int * owners = new int [num_Tetrads];
+    
+    for (i = 0; i < num_Tetrads; i++) { mark[i] = -1; }
+    
+    // The halo received from master
+    if (!integration) {
+        if (MPI_Halo != MPI_DATATYPE_NULL) mpi.free_MPI_Crds(&MPI_Halo);
+        count = mpi.list_Halo(rank, ED_Index, NB_Index, pair_Lists, list, mark);
+        if (count > 0) mpi.create_MPI_Halo(&MPI_Halo, count, list, tetrad);
         
-        edmd.calculate_ED_Forces(&(tetrad[i]));
-        edmd.calculate_Random_Terms(&(tetrad[i]), rank);
+        delete [] list; delete [] mark; delete [] owners;
+        return;
+    }
+    
+    // The owners of tetrads
+    for (r = 0; r < size; r++) {
+        for (i = ED_Index[r][0]; i < ED_Index[r][0] + ED_Index[r][1]; i++) { owners[i] = r; }
+    }
+    
+    for (r = 1; r < size; r++) {
         
-        MPI_Isend(&(tetrad[i]), 1, MPI_ED_Forces[i], 0, TAG_ED + i, comm, &(send_Request[i - ED_Index[rank - 1][0]]));
+        if (halo_Send[r] != MPI_DATATYPE_NULL) mpi.free_MPI_Crds(&(halo_Send[r]));
+        if (halo_Recv[r] != MPI_DATATYPE_NULL) mpi.free_MPI_Crds(&(halo_Recv[r]));
+        if (r == rank) continue;
         
+        // The own tetrads in the halo of worker r
+        count = mpi.list_Halo(r, ED_Index, NB_Index, pair_Lists, list, mark);
+        for (j = 0, i = 0; i < count; i++) {
+            if (owners[list[i]] == rank) list[j++] = list[i];
+        }
+        if (j > 0) mpi.create_MPI_Halo(&(halo_Send[r]), j, list, tetrad);
     }
     
-    // Calculate the NB forces
-    empty_NB_Forces();
-    for (i = NB_Index[rank - 1][0]; i < NB_Index[rank - 1][0] + NB_Index[rank - 1][1]; i++) {
+    // The halo of this worker, grouped by the owners (as the list is sorted)
+    count = mpi.list_Halo(rank, ED_Index, NB_Index, pair_Lists, list, mark);
+    for (i = 0; i < count; i = j) {
+        owner = owners[list[i]];
+        for (j = i; j < count && owners[list[j]] == owner; j++);
+        if (owner == rank) continue;
+        mpi.create_MPI_Halo(&(halo_Recv[owner]), j - i, &(list[i]), tetrad);
+    }
+    
+    delete [] list;
+    delete [] mark;
+    delete [] owners;
+    
+}
+
+
+
+void Worker::integrate_Tetrads(int steps) {
+    
+    int i, k, step, width = 3 * max_Atoms + 2;
+    int start = ED_Index[rank][0], count = ED_Index[rank][1];
+    int counts[size - 1], displs[size - 1], rows[size - 1];
+    double start_Time, ED_Sum = 0.0, NB_Sum = 0.0;
+    MPI_Request send_Request[count];
+    MPI_Status send_Status[count];
+    
+    // The coordinates & the NB force rows of the tetrads of every worker
+    for (i = 1; i < size; i++) {
+        displs[i - 1] = crd_Displs[ED_Index[i][0]];
+        counts[i - 1] = crd_Displs[ED_Index[i][0] + ED_Index[i][1]] - displs[i - 1];
+        rows[i - 1]   = ED_Index[i][1] * width;
+    }
+    
+    for (step = 0; step < steps; step++) {
         
-        i1 = pair_Lists[i][0];
-        i2 = pair_Lists[i][1];
-        edmd.calculate_NB_Forces(&tetrad[i1], &tetrad[i2]);
+        // The coordinates of the first step are broadcast by master
+        if (step > 0) exchange_Crds(counts, displs);
         
-        // Sum up the NB forces of the specific tetrads
-        for (j = 0; j < 3 * tetrad[i1].num_Atoms + 2; j++) {
-            NB_Forces[i1][j] += tetrad[i1].NB_Forces[j];
+        // Calculate the ED forces & the random terms of the tetrad at this step
+        // (while the tetrad is in cache), the energies only at the last step
+        energy_Step = (step == steps - 1);
+        start_Time = MPI_Wtime();
+        #pragma omp parallel for schedule(dynamic)
+        for (i = start; i < start + count; i++) {
+            edmd.calculate_ED_Forces(&(tetrad[i]), energy_Step);
+            edmd.calculate_Random_Terms(&(tetrad[i]), i, md_Step);
         }
-        for (j = 0; j < 3 * tetrad[i2].num_Atoms + 2; j++) {
-            NB_Forces[i2][j] += tetrad[i2].NB_Forces[j];
+        ED_Sum += MPI_Wtime() - start_Time;
+        
+        // Calculate the NB forces at the first step & the last step of every
+        // nb_Interval steps. In between, the rows of the own tetrads are held
+        // (multiple time stepping)
+        if (step == 0 || (step + 1) % nb_Interval == 0) {
+            start_Time = MPI_Wtime();
+            empty_NB_Forces();
+            calculate_NB_Pairs(NB_Index[rank][0], NB_Index[rank][1]);
+            sum_Thread_Forces();
+            NB_Sum += MPI_Wtime() - start_Time;
+            
+            // Sum up the NB forces, every worker gets the rows of its own tetrads
+            MPI_Reduce_scatter(MPI_IN_PLACE, &(NB_Forces[0][0]), rows, MPI_DOUBLE, MPI_SUM, MD_Comm);
+        }
+        
+        // Update the velocities & coordinates with the (clipped) NB forces
+        #pragma omp parallel for schedule(static)
+        for (k = 0; k < count; k++) {
+            edmd.integrate_Tetrad(&(tetrad[start + k]), NB_Forces[k]);
         }
+        md_Step++;
     }
     
-    // Reduce & sum up the NB forces to the master
-    MPI_Reduce(&(NB_Forces[0][0]), &(NB_Forces[0][0]), num_Tetrads * (3 * max_Atoms + 2), MPI_DOUBLE, MPI_SUM, 0, comm);
+    // Send the states of the tetrads to master
+    for (i = start; i < start + count; i++) {
+        MPI_Isend(&(tetrad[i]), 1, MPI_State[i], 0, TAG_ED + i, comm, &(send_Request[i - start]));
+    }
     
-    // Wait all ED forces to be received
-    MPI_Waitall(workload, send_Request, send_Status);
+    // Reduce the timings of the steps to master
+    if (load_Balance) {
+        double timings[2 * size];
+        for (i = 0; i < 2 * size; i++) { timings[i] = 0.0; }
+        timings[2 * rank] = ED_Sum; timings[2*rank+1] = NB_Sum;
+        MPI_Reduce(timings, timings, 2 * size, MPI_DOUBLE, MPI_SUM, 0, comm);
+    }
+    
+    MPI_Waitall(count, send_Request, send_Status);
+    
+}
+
+
+
+void Worker::exchange_Crds(int* counts, int* displs) {
+    
+    int i;
+    
+    // Receive the halo from the owners & send the own tetrads to the workers
+    // which need them
+    if (crd_Exchange) {
+        MPI_Request halo_Request[2 * size];
+        for (i = 1; i < size; i++) {
+            halo_Request[2 * i] = halo_Request[2*i+1] = MPI_REQUEST_NULL;
+            if (halo_Recv[i] != MPI_DATATYPE_NULL) {
+                MPI_Irecv(tetrad, 1, halo_Recv[i], i - 1, TAG_CRDS, MD_Comm, &(halo_Request[2 * i]));
+            }
+            if (halo_Send[i] != MPI_DATATYPE_NULL) {
+                MPI_Isend(tetrad, 1, halo_Send[i], i - 1, TAG_CRDS, MD_Comm, &(halo_Request[2*i+1]));
+            }
+        }
+        MPI_Waitall(2 * size - 2, &(halo_Request[2]), MPI_STATUSES_IGNORE);
+        return;
+    }
+    
+    // The coordinates of all tetrads are in a contiguous buffer
+    MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, tetrad[0].coordinates, counts, displs, MPI_DOUBLE, MD_Comm);
+    
+}
+
+
+
+void Worker::calculate_NB_Pairs(int start, int count) {
+    
+    int i, j, i1, i2, width = 3 * max_Atoms + 2;
+    
+    #pragma omp parallel private(j, i1, i2)
+    {
+        int tid = 0;
+#ifdef _OPENMP
+        tid = omp_get_thread_num();
+#endif
+        // The NB forces of a pair are calculated into the scratch of the thread
+        // (tetrads are shared by threads), and summed up into its rows of the two
+        // tetrads. The threads take contiguous blocks of pairs, so they touch few
+        // tetrads (the pair lists are ordered by tetrads)
+        Tetrad t1, t2;
+        double * f1, * f2;
+        
+        #pragma omp for schedule(static)
+        for (i = start; i < start + count; i++) {
+            
+            i1 = pair_Lists[i][0];
+            i2 = pair_Lists[i][1];
+            t1 = NB_Tetrad[i1]; t1.NB_Forces = thread_Scratch[tid];
+            t2 = NB_Tetrad[i2]; t2.NB_Forces = thread_Scratch[tid] + width;
+            edmd.calculate_NB_Forces(&t1, &t2, energy_Step);
+            
+            // The rows of the thread may grow, so both slots are taken first
+            if (tid == 0) {
+                f1 = NB_Forces[i1]; f2 = NB_Forces[i2];
+            } else {
+                int s1 = thread_Slot(tid, i1), s2 = thread_Slot(tid, i2);
+                f1 = thread_Forces[tid] + s1 * width; f2 = thread_Forces[tid] + s2 * width;
+            }
+            
+            // Sum up the NB forces of the specific tetrads
+            for (j = 0; j < 3 * t1.num_Atoms + 2; j++) {
+                f1[j] += t1.NB_Forces[j];
+            }
+            for (j = 0; j < 3 * t2.num_Atoms + 2; j++) {
+                f2[j] += t2.NB_Forces[j];
+            }
+        }
+    }
+    
+    for (i = start; i < start + count; i++) {
+        touched[(int) pair_Lists[i][0]] = touched[(int) pair_Lists[i][1]] = 1;
+    }
+    
+}
+
+
+
+int Worker::thread_Slot(int tid, int index) {
+    
+    int j, slot = thread_Slots[tid][index], width = 3 * max_Atoms + 2;
+    
+    if (slot >= 0) return slot;
+    
+    // Double the rows of the thread (at most one per tetrad)
+    if (thread_Count[tid] == thread_Capacity[tid]) {
+        int capacity = min(num_Tetrads, max(16, 2 * thread_Capacity[tid]));
+        double * rows = new double [capacity * width];
+        if (thread_Count[tid] > 0) memcpy(rows, thread_Forces[tid], thread_Count[tid] * width * sizeof(double));
+        delete [] thread_Forces[tid];
+        thread_Forces[tid] = rows; thread_Capacity[tid] = capacity;
+    }
+    
+    slot = thread_Slots[tid][index] = thread_Count[tid]++;
+    for (j = 0; j < width; j++) { thread_Forces[tid][slot * width + j] = 0.0; }
+    
+    return slot;
+    
+}
+
+
+
+void Worker::sum_Thread_Forces(void) {
+    
+    int i, j, k, slot, width = 3 * max_Atoms + 2;
+    
+    if (num_Threads == 1) return;
+    
+    #pragma omp parallel for private(j, k, slot) schedule(static)
+    for (i = 0; i < num_Tetrads; i++) {
+        if (!touched[i]) continue;
+        for (k = 1; k < num_Threads; k++) {
+            slot = thread_Slots[k][i];
+            if (slot < 0) continue;
+            for (j = 0; j < 3 * tetrad[i].num_Atoms + 2; j++) {
+                NB_Forces[i][j] += thread_Forces[k][slot * width + j];
+            }
+            thread_Slots[k][i] = -1;
+        }
+    }
+    for (k = 1; k < num_Threads; k++) { thread_Count[k] = 0; }
+    
+}
+
+
+
+void Worker::reduce_NB_Rows(void) {
+    
+    int mask, nb_Rank, nb_Size;
+    
+    MPI_Comm_rank(NB_Comm, &nb_Rank);
+    MPI_Comm_size(NB_Comm, &nb_Size);
+    
+    // The timings of this worker are always sent
+    for (int i = num_Tetrads; i < num_Rows; i++) { touched[i] = 1; }
+    
+    if (nb_Reduce == 1) {
+        send_NB_Rows(0);
+        return;
+    }
+    
+    // The binomial tree: sum up the rows of the children (rank + 1, 2, 4, ...)
+    // until the lowest set bit of rank, then send them to the parent
+    for (mask = 1; mask < nb_Size; mask <<= 1) {
+        if (nb_Rank & mask) {
+            send_NB_Rows(nb_Rank - mask);
+            return;
+        }
+        if (nb_Rank + mask < nb_Size) sum_NB_Rows(nb_Rank + mask);
+    }
+    
+}
+
+
+
+void Worker::send_NB_Rows(int dest) {
+    
+    int i, j, count, width = 3 * max_Atoms + 2;
+    
+    for (count = 0, i = 0; i < num_Rows; i++) {
+        if (!touched[i]) continue;
+        NB_Rows[count++] = i;
+        for (j = 0; j < width; j++) { NB_Rows[count++] = NB_Forces[i][j]; }
+        touched[i] = 0;
+    }
+    
+    MPI_Isend(NB_Rows, count, MPI_DOUBLE, dest, TAG_NB, NB_Comm, &NB_Request);
+    
+}
+
+
+
+void Worker::sum_NB_Rows(int source) {
+    
+    int j, k, row, count, width = 3 * max_Atoms + 2;
+    MPI_Status recv_Status;
+    
+    MPI_Recv(NB_Rows, num_Rows * (width + 1), MPI_DOUBLE, source, TAG_NB, NB_Comm, &recv_Status);
+    MPI_Get_count(&recv_Status, MPI_DOUBLE, &count);
+    
+    for (j = 0; j < count; j += width + 1) {
+        row = (int) NB_Rows[j];
+        touched[row] = 1;
+        for (k = 0; k < width; k++) { NB_Forces[row][k] += NB_Rows[j + 1 + k]; }
+    }
     
 }
 
@@ -195,6 +951,11 @@ void Worker::empty_NB_Forces(void) {
             NB_Forces[i][j] = 0.0;
         }
     }
+    for (int i = num_Tetrads; i < num_Rows; i++) {
+        for (int j = 0; j < 3 * max_Atoms + 2; j++) {
+            NB_Forces[i][j] = 0.0;
+        }
+    }
     
 }
 
@@ -22,7 +22,11 @@
 
 #include <iostream>
 #include <ctime>
+#include <algorithm>
 #include "mpi.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "array.hpp"
 #include "mpilib.hpp"
@@ -45,6 +49,8 @@ public:
     
     Tetrad *tetrad;  // The tetrads array
     
+    Tetrad *NB_Tetrad; // The tetrads for the NB forces (with the shared coordinates of the node)
+    
     EDMD edmd;       // For calculating the ED and NB forces
     
     Array array;     // For 2D array operations
@@ -55,20 +61,141 @@ public:
     
     int num_Pairs;   // The number of non-bonded pairs
     
+    int nb_Schedule; // The NB workload schedule (0: static, 1: dynamic, 2: guided)
+    
+    int nb_Chunk;    // The (minimum) number of pairs per chunk in dynamic schedules
+    
+    int num_Chunks;  // The number of chunks of the pair lists
+    
+    int load_Balance; // Report the measured time of force calculation (0: off, 1: on)
+    
+    int nb_Partition; // The pair-to-worker assignment (0: pair list order, 1: locality)
+    
+    int ed_Workers;   // The ED & NB groups of workers (0: off, otherwise on)
+    
+    int ed_Group;     // The number of workers in the ED group (0: no groups)
+    
+    int split_Group;  // The ed_Group of the current ED & NB communicators (-1: none)
+    
+    int nb_Reduce;    // The NB force reduction (0: dense, 1: touched rows, 2: tree of touched rows)
+    
+    int nb_Overlap;   // Overlap the NB force reduction with the ED forces (0: off, 1: on)
+    
+    double ED_Time;   // The measured time of the ED forces (of the last step)
+    
+    int md_Step;      // The number of steps integrated (the counter of the random terms)
+    
+    int nb_Interval;  // The NB forces are calculated every nb_Interval steps (multiple time stepping)
+    
+    int nb_Step;      // Calculate the NB forces at this step (otherwise they are held)
+    
+    int energy_Step;  // Calculate the energies at this step (the last step before output)
+    
+    int pc_Integration; // The tetrads are integrated in the PC subspace (the coordinates are
+                        // reconstructed from the PC amplitudes & frames in the header)
+    
+    int integration;  // The integration of tetrads (0: on master, 1: distributed on workers)
+    
+    int crd_Exchange; // The coordinates received (0: all tetrads, 1: halo of needed tetrads)
+    
+    int shm_Node;     // Share the coordinates & NB forces in the memory of nodes (0: off, 1: on)
+    
+    int node_Rank;    // The rank of this worker in its node
+    
+    int node_Size;    // The number of processes of the node
+    
+    int omp_Threads;  // The number of OpenMP threads in config (0: the OpenMP default)
+    
+    int num_Threads;  // The number of OpenMP threads of this worker
+    
     double ** pair_Lists; // The 2D array of NB pair lists
     
-    int    ** NB_Index;   // The workload distribution of NB force caulcaiton
+    int    ** NB_Index;   // The workload distribution of NB force caulcaiton (by rank)
+    
+    int    ** ED_Index;   // The workload distribution of ED force caulcaiton (by rank)
+    
+    int    ** NB_Chunks;  // The chunks of the pair lists for dynamic NB scheduling
+    
+    double ** NB_Forces;  // The 2D array to store the NB forces (& timings of workers)
+    
+    int      num_Rows;    // The number of rows of the NB force array to be reduced
+    
+    int    * touched;     // Whether the rows of the NB force array are touched
+    
+    double * NB_Rows;     // The touched rows of NB forces to be sent (led by row index)
+    
+    int    * crd_Displs;  // The displacements of tetrads in the coordinate buffer
+    
+    double * shm_Crds;    // The coordinates of all tetrads in the shared memory of the node
+    
+    double ** node_Forces; // The NB force arrays of the processes of the node (shared memory)
     
-    int    ** ED_Index;   // The workload distribution of ED force caulcaiton
+    double ** thread_Forces;  // The rows of NB forces of the threads, only for the tetrads
+                              // a thread touches (thread 0 uses NB_Forces)
     
-    double ** NB_Forces;  // The 2D array to store the NB forces
+    int ** thread_Slots;      // The row of every tetrad in the rows of a thread (-1: none)
+    
+    int * thread_Count;       // The number of rows of the threads in use
+    
+    int * thread_Capacity;    // The number of rows allocated for the threads
+    
+    double ** thread_Scratch; // The NB forces of a pair of tetrads (by thread)
     
     MPI_Comm comm;        // The MPI communicator
     
-    MPI_Datatype * MPI_ED_Forces; // For receiving the ED forces & random terms
+    MPI_Comm ED_Comm;     // The communicator of master & the ED group
+    
+    MPI_Comm NB_Comm;     // The communicator of master & the NB group (or all workers)
+    
+    MPI_Comm MD_Comm;     // The communicator of workers (the distributed integration)
+    
+    MPI_Comm node_Comm;   // The communicator of the processes of the node
+    
+    MPI_Comm leader_Comm; // The communicator of the leaders of nodes (master is rank 0)
+    
+    MPI_Win  crd_Win;     // The shared memory window of the coordinates
+    
+    MPI_Win  force_Win;   // The shared memory window of the NB force arrays
+    
+    MPI_Datatype * MPI_ED_Forces; // For sending the ED forces (& the shaken coordinates)
     
     MPI_Datatype   MPI_Crds;      // For receiving the coordinates of all tetrads
     
+    MPI_Datatype   MPI_ED_Crds;   // For receiving the coordinates of the own tetrads (ED group)
+    
+    MPI_Win        NB_Win;        // For taking NB chunks from the counter on master
+    
+    MPI_Request    NB_Request;    // The request of the (non-blocking) NB reduction
+    
+    MPI_Datatype * MPI_State;     // For sending the states of tetrads (distributed integration)
+    
+    MPI_Datatype   MPI_Vels_n_Crds; // For receiving the velocities & coordinates of all tetrads
+    
+    MPI_Datatype   MPI_Halo;      // For receiving the coordinates of the halo from master
+    
+    MPI_Datatype * halo_Send;     // For sending the own coordinates in the halo of workers (by rank)
+    
+    MPI_Datatype * halo_Recv;     // For receiving the coordinates of the halo from owners (by rank)
+    
+    int            header[2];     // The header of commands from master (command & argument)
+    
+    int            header_Crds;   // The coordinates are broadcast with the header (0: no, 1: yes)
+    
+    int            crd_Headers;   // The force commands left in the sync (their headers carry
+                                  // the coordinates, TAG_PAIRS & TAG_END are the bare header)
+    
+    int            crd_Precision; // The coordinates broadcast by master (0: double, 1: float,
+                                  // 2: float deltas from the full-precision frame of the last sync)
+    
+    float        * crd_Floats;    // The coordinates (or the deltas) received in reduced precision
+    
+    double       * crd_Ref;       // The coordinates of the last full-precision frame (deltas)
+    
+    MPI_Datatype   MPI_Header;    // For receiving the header with the coordinates (or the
+                                  // velocities & coordinates) of all tetrads
+    
+    MPI_Datatype   MPI_PC_Crds;   // For receiving the PC amplitudes & frames of all tetrads
+    
 public:
     
     /**
@@ -109,7 +236,8 @@ public:
     void recv_Tetrads(void);
     
     /**
-     * Function:  Receive new messages from master & calculate the ED/NB forces
+     * Function:  Receive the commands of master (blocking in the header broadcast)
+     *            & calculate the ED/NB forces until the terminate command
      *
      * Parameter: None
      *
@@ -117,6 +245,90 @@ public:
      */
     void recv_Messages(void);
     
+    /**
+     * Function:  Receive the header of a command from master (with the coordinates
+     *            of all tetrads, or the velocities & coordinates with the distributed
+     *            integration, for the force commands when every worker needs them)
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void recv_Header(void);
+    
+    /**
+     * Function:  Decode the coordinates of all tetrads received in reduced precision
+     *            (float, or float deltas from the last full-precision frame)
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void decode_Crds(void);
+    
+    /**
+     * Function:  Join the ED or the NB group (communicator) decided by master, and
+     *            create the MPI_Datatype of the own tetrads for the ED group.
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void setup_Groups(void);
+    
+    /**
+     * Function:  Create the MPI_Datatype of the halo of this worker (the tetrads it
+     *            needs for its ED & NB force calculation). With the distributed
+     *            integration, the halo is received from the owners of tetrads, and
+     *            the own tetrads in the halo of other workers are sent to them.
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void setup_Halo(void);
+    
+    /**
+     * Function:  Allocate the coordinates of all tetrads (one array per node) and
+     *            the NB force arrays of processes in the shared memory of nodes
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void setup_Shared(void);
+    
+    /**
+     * Function:  Synchronise the shared memory of a window among the processes of
+     *            the node
+     *
+     * Parameter: MPI_Win win -> The shared memory window
+     *
+     * Return:    None
+     */
+    void sync_Node(MPI_Win win);
+    
+    /**
+     * Function:  The leaders of nodes receive the coordinates of all tetrads into
+     *            the shared memory, and workers copy the coordinates of the tetrads
+     *            of their ED forces
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void share_Crds(void);
+    
+    /**
+     * Function:  Sum up the NB force arrays of the node in the shared memory (every
+     *            process takes a slice of rows), and reduce the sums of nodes
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void reduce_Node_Forces(void);
+    
     /**
      * Function:  Receive the coordinates of all tetrads from master, compute NB
      *            forces of specified tetrads, sum them up and reduce them to master
@@ -128,7 +340,113 @@ public:
     void force_Calculation();
     
     /**
-     * Function:  Set the NB forces of tetrads to 0.
+     * Function:  Compute the ED forces of the tetrads of this worker
+     *            and start to send them to master
+     *
+     * Parameter: MPI_Request* send_Request -> The requests of the sends (one per tetrad)
+     *
+     * Return:    The elapsed time
+     */
+    double calculate_ED_Share(MPI_Request* send_Request);
+    
+    /**
+     * Function:  Compute the NB forces of the static range of this worker, or of the
+     *            chunks taken from the counter on master
+     *
+     * Parameter: None
+     *
+     * Return:    The elapsed time
+     */
+    double calculate_NB_Share(void);
+    
+    /**
+     * Function:  Integrate the tetrads of this worker (ED_Index) for a number of
+     *            steps. The coordinates of the tetrads are exchanged among workers,
+     *            and the NB forces are reduced & scattered to the owners of tetrads
+     *            every step. The states of tetrads are sent to master at the end.
+     *
+     * Parameter: int steps -> The number of steps
+     *
+     * Return:    None
+     */
+    void integrate_Tetrads(int steps);
+    
+    /**
+     * Function:  Gather the coordinates of the tetrads of all workers (or only of
+     *            the halo from their owners)
+     *
+     * Parameter: int* counts -> The number of coordinates of every worker
+     *            int* displs -> The displacements of workers in the coordinate buffer
+     *
+     * Return:    None
+     */
+    void exchange_Crds(int* counts, int* displs);
+    
+    /**
+     * Function:  Compute the NB forces of a contiguous range of the pair lists and
+     *            sum them up into the rows of NB forces of the threads
+     *
+     * Parameter: int start -> The index of the first pair
+     *            int count -> The number of pairs
+     *
+     * Return:    None
+     */
+    void calculate_NB_Pairs(int start, int count);
+    
+    /**
+     * Function:  The row of a tetrad in the rows of NB forces of a thread. A new row
+     *            is set to 0 (the rows of the thread grow when they are full).
+     *
+     * Parameter: int tid   -> The thread (not 0)
+     *            int index -> The index of the tetrad
+     *
+     * Return:    The row of the tetrad
+     */
+    int thread_Slot(int tid, int index);
+    
+    /**
+     * Function:  Sum up the rows of NB forces of the threads into the NB force array
+     *            (in the order of threads) and release the rows.
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void sum_Thread_Forces(void);
+    
+    /**
+     * Function:  Reduce the touched rows of NB forces to master, directly or along a
+     *            binomial tree of the NB group (where the rows of the children are
+     *            summed up before they are sent to the parent).
+     *
+     * Parameter: None
+     *
+     * Return:    None
+     */
+    void reduce_NB_Rows(void);
+    
+    /**
+     * Function:  Pack the touched rows of NB forces (each led by its row index) &
+     *            start to send them (NB_Request). The touched flags are cleared.
+     *
+     * Parameter: int dest -> The rank (in NB_Comm) of the receiver
+     *
+     * Return:    None
+     */
+    void send_NB_Rows(int dest);
+    
+    /**
+     * Function:  Receive a message of touched rows of NB forces & sum them up into
+     *            the NB force array. The rows are marked as touched.
+     *
+     * Parameter: int source -> The rank (in NB_Comm) of the sender
+     *
+     * Return:    None
+     */
+    void sum_NB_Rows(int source);
+    
+    /**
+     * Function:  Set the NB forces of tetrads (& the timings) to 0.
      *
      * Parameter: None
      *